@@ -0,0 +1,751 @@
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+#include "executor.h"
+#include "node_pool.h"
+#include "parker.h"
+#include "queue_internal.h"
+
+// Constants
+#define DEQUE_INITIAL_CAPACITY 256
+
+// Struct defs
+typedef struct {
+    ExecutorTask task;
+    void *argument;
+} TaskNode;
+
+typedef struct WorkArray {
+    long capacity;
+    struct WorkArray *previous;
+    _Atomic(TaskNode*) slots[];
+} WorkArray;
+
+typedef struct {
+    _Alignas(QUEUE_CACHE_LINE) atomic_long top;
+    _Alignas(QUEUE_CACHE_LINE) atomic_long bottom;
+    _Atomic(WorkArray*) array;
+} WorkDeque;
+
+typedef enum {
+    STEAL_SUCCESS,
+    STEAL_EMPTY,
+    STEAL_ABORT,
+} StealResult;
+
+typedef struct {
+    WorkDeque deque;
+    Executor *executor;
+    size_t index;
+    thrd_t thread;
+    uint32_t random_state;
+    TaskNode *found_task;
+    atomic_size_t executed_tasks;
+    atomic_size_t stolen_tasks;
+    atomic_size_t idle_periods;
+} ExecutorWorker;
+
+struct Executor {
+    ConcurrentQueue *global_queue;
+    ExecutorWorker *workers;
+    size_t worker_amount;
+    Parker idle_workers;
+    atomic_bool accepting;
+    atomic_bool stopping;
+    atomic_size_t pending_tasks;
+    mtx_t idle_lock;
+    cnd_t idle_condition;
+};
+
+
+// Function declaration
+static bool init_workers(Executor*);
+static void destroy_executor(Executor*, size_t);
+static int worker_main(void*);
+static bool attempt_find_work(void*);
+static TaskNode* find_work(ExecutorWorker*);
+static TaskNode* steal_work(ExecutorWorker*);
+static void run_task(ExecutorWorker*, TaskNode*);
+static void finish_task(Executor*);
+static TaskNode* init_task_node(ExecutorTask, void*);
+static void release_task_node(TaskNode*);
+static bool deque_init(WorkDeque*);
+static void deque_destroy(WorkDeque*);
+static bool deque_push(WorkDeque*, TaskNode*);
+static TaskNode* deque_take(WorkDeque*);
+static StealResult deque_steal(WorkDeque*, TaskNode**);
+static WorkArray* init_work_array(long);
+static WorkArray* grow_work_array(WorkDeque*, WorkArray*, long, long);
+
+
+// Global variables declarations
+static _Thread_local ExecutorWorker *current_worker;
+
+/*Interface methods*/
+
+/**
+ * @brief Creates a work stealing executor and starts its worker threads.
+ *
+ * The global queue, the parker idle workers sleep on and every worker's deque are set up before the first
+ * thread starts. If a thread can not be started the ones already running are stopped and joined.
+ *
+ * @param worker_amount The amount of worker threads, at least 1.
+ * @param global_config The configuration of the global queue, NULL for the default configuration. Tasks
+ * are passed through the global queue as pointers, so its element_size is reset.
+ *
+ * @return A pointer to the new executor, or NULL if it could not be created.
+ *
+ */
+Executor* executorCreate(size_t worker_amount, const QueueConfig *global_config) {
+    // Variable declaration
+    Executor *executor;
+    QueueConfig queue_config;
+    size_t i;
+
+    if (worker_amount == 0) {
+        return NULL;
+    }
+
+    executor = malloc(sizeof(Executor));
+    if (executor == NULL) {
+        return NULL;
+    }
+
+    if (global_config == NULL) {
+        queueDefaultConfig(&queue_config);
+    }
+    else {
+        queue_config = *global_config;
+    }
+    queue_config.element_size = 0;
+    executor->global_queue = queueCreateWithConfig(&queue_config);
+    if (executor->global_queue == NULL) {
+        free(executor);
+        return NULL;
+    }
+    if (!parker_init(&executor->idle_workers)) {
+        queueDestroy(executor->global_queue);
+        free(executor);
+        return NULL;
+    }
+    if (mtx_init(&executor->idle_lock, mtx_plain) != thrd_success) {
+        parker_destroy(&executor->idle_workers);
+        queueDestroy(executor->global_queue);
+        free(executor);
+        return NULL;
+    }
+    if (cnd_init(&executor->idle_condition) != thrd_success) {
+        mtx_destroy(&executor->idle_lock);
+        parker_destroy(&executor->idle_workers);
+        queueDestroy(executor->global_queue);
+        free(executor);
+        return NULL;
+    }
+
+    atomic_init(&executor->accepting, true);
+    atomic_init(&executor->stopping, false);
+    atomic_init(&executor->pending_tasks, 0);
+    executor->worker_amount = worker_amount;
+    if (!init_workers(executor)) {
+        cnd_destroy(&executor->idle_condition);
+        mtx_destroy(&executor->idle_lock);
+        parker_destroy(&executor->idle_workers);
+        queueDestroy(executor->global_queue);
+        free(executor);
+        return NULL;
+    }
+
+    for (i = 0; i < worker_amount; i++) {
+        if (thrd_create(&executor->workers[i].thread, worker_main, &executor->workers[i]) != thrd_success) {
+            destroy_executor(executor, i);
+            return NULL;
+        }
+    }
+    return executor;
+}
+
+/**
+ * @brief Submits a task to the executor.
+ *
+ * The task is counted as pending before it is published, so executorWaitIdle never returns while it is
+ * on its way. Workers push onto their own deque without touching any shared state but the deque's bottom.
+ * External threads enqueue into the global queue and are rejected once executorShutdown started, while
+ * workers keep submitting so the tasks they run can finish their work during the shutdown. Either way one
+ * idle worker is woken up, which costs a single atomic load while no worker is idle.
+ *
+ * @param executor The executor to run the task.
+ * @param task The function to run.
+ * @param argument The argument passed to task.
+ *
+ * @return True if the task was submitted, false if memory allocation failed or the executor is shutting
+ * down and the calling thread is not one of its workers.
+ *
+ */
+bool executorSubmit(Executor *executor, ExecutorTask task, void *argument) {
+    // Variable declaration
+    TaskNode *task_node;
+    bool submitted;
+
+    task_node = init_task_node(task, argument);
+    if (task_node == NULL) {
+        return false;
+    }
+    atomic_fetch_add(&executor->pending_tasks, 1);
+
+    if (current_worker != NULL && current_worker->executor == executor) {
+        submitted = deque_push(&current_worker->deque, task_node);
+    }
+    else {
+        submitted = atomic_load(&executor->accepting) && queueEnqueue(executor->global_queue, task_node);
+    }
+
+    if (!submitted) {
+        release_task_node(task_node);
+        finish_task(executor);
+        return false;
+    }
+    parker_wake(&executor->idle_workers);
+    return true;
+}
+
+/**
+ * @brief Blocks until the amount of pending tasks drops to zero.
+ *
+ * @param executor The executor to wait for.
+ *
+ */
+void executorWaitIdle(Executor *executor) {
+    mtx_lock(&executor->idle_lock);
+    while (atomic_load(&executor->pending_tasks) != 0) {
+        cnd_wait(&executor->idle_condition, &executor->idle_lock);
+    }
+    mtx_unlock(&executor->idle_lock);
+}
+
+/**
+ * @brief Stops accepting external tasks, runs the remaining ones, joins the workers and frees the executor.
+ *
+ * Since a submission is counted as pending before it checks whether the executor still accepts tasks,
+ * every accepted task is either seen by executorWaitIdle or submitted by a task that is. Only then the
+ * workers are told to stop.
+ *
+ * @param executor The executor to shut down.
+ *
+ */
+void executorShutdown(Executor *executor) {
+    atomic_store(&executor->accepting, false);
+    executorWaitIdle(executor);
+    destroy_executor(executor, executor->worker_amount);
+}
+
+/**
+ * @brief Returns the amount of worker threads of the executor.
+ *
+ * @param executor The executor to query.
+ *
+ */
+size_t executorWorkerAmount(Executor *executor) {
+    return executor->worker_amount;
+}
+
+/**
+ * @brief Reads the counters of one worker.
+ *
+ * @param executor The executor to query.
+ * @param worker_index The index of the worker, below executorWorkerAmount.
+ * @param stats A pointer to the location in which to save the counters.
+ *
+ * @return True on success, false if worker_index is out of range.
+ *
+ */
+bool executorWorkerStats(Executor *executor, size_t worker_index, ExecutorWorkerStats *stats) {
+    // Variable declaration
+    ExecutorWorker *worker;
+
+    if (worker_index >= executor->worker_amount) {
+        return false;
+    }
+
+    worker = &executor->workers[worker_index];
+    stats->executed_tasks = atomic_load_explicit(&worker->executed_tasks, memory_order_relaxed);
+    stats->stolen_tasks = atomic_load_explicit(&worker->stolen_tasks, memory_order_relaxed);
+    stats->idle_periods = atomic_load_explicit(&worker->idle_periods, memory_order_relaxed);
+    return true;
+}
+
+/*Private methods*/
+
+/**
+ * @brief Allocates the cache line aligned worker array and initializes every worker and its deque.
+ *
+ * @param executor The executor whose workers to initialize.
+ *
+ * @return True on success, false if memory allocation failed.
+ *
+ * @note Used by executorCreate.
+ *
+ */
+static bool init_workers(Executor *executor) {
+    // Variable declaration
+    ExecutorWorker *worker;
+    size_t i;
+
+    executor->workers = aligned_alloc(QUEUE_CACHE_LINE, executor->worker_amount * sizeof(ExecutorWorker));
+    if (executor->workers == NULL) {
+        return false;
+    }
+
+    for (i = 0; i < executor->worker_amount; i++) {
+        worker = &executor->workers[i];
+        if (!deque_init(&worker->deque)) {
+            while (i > 0) {
+                deque_destroy(&executor->workers[--i].deque);
+            }
+            free(executor->workers);
+            return false;
+        }
+        worker->executor = executor;
+        worker->index = i;
+        worker->random_state = (uint32_t)(i + 1) * 2654435761u;
+        worker->found_task = NULL;
+        atomic_init(&worker->executed_tasks, 0);
+        atomic_init(&worker->stolen_tasks, 0);
+        atomic_init(&worker->idle_periods, 0);
+    }
+    return true;
+}
+
+/**
+ * @brief Stops and joins the running workers, then frees every resource of the executor.
+ *
+ * @param executor The executor to destroy, which must have no pending tasks.
+ * @param running_workers The amount of workers whose threads were started.
+ *
+ * @note Used by executorCreate and executorShutdown.
+ *
+ */
+static void destroy_executor(Executor *executor, size_t running_workers) {
+    // Variable declaration
+    size_t i;
+
+    atomic_store(&executor->stopping, true);
+    parker_wake_all(&executor->idle_workers);
+    for (i = 0; i < running_workers; i++) {
+        thrd_join(executor->workers[i].thread, NULL);
+    }
+
+    for (i = 0; i < executor->worker_amount; i++) {
+        deque_destroy(&executor->workers[i].deque);
+    }
+    free(executor->workers);
+    cnd_destroy(&executor->idle_condition);
+    mtx_destroy(&executor->idle_lock);
+    parker_destroy(&executor->idle_workers);
+    queueDestroy(executor->global_queue);
+    free(executor);
+}
+
+/**
+ * @brief The main loop of a worker thread.
+ *
+ * Local tasks are taken from the bottom of the worker's deque first, so recently submitted tasks run while
+ * their data is still in cache. Out of local work, the worker looks for work elsewhere and, if there is
+ * none, counts an idle period and parks until a submission or the shutdown wakes it up.
+ *
+ * @param context The worker running the loop.
+ *
+ * @return Always 0.
+ *
+ * @note Used by executorCreate as the thread start routine.
+ *
+ */
+static int worker_main(void *context) {
+    // Variable declaration
+    ExecutorWorker *worker = context;
+    TaskNode *task_node;
+
+    current_worker = worker;
+    for (;;) {
+        task_node = deque_take(&worker->deque);
+        if (task_node == NULL) {
+            task_node = find_work(worker);
+        }
+        if (task_node == NULL) {
+            atomic_fetch_add_explicit(&worker->idle_periods, 1, memory_order_relaxed);
+            parker_wait(&worker->executor->idle_workers, attempt_find_work, worker);
+            task_node = worker->found_task;
+            if (task_node == NULL) {
+                break;
+            }
+        }
+        run_task(worker, task_node);
+    }
+    current_worker = NULL;
+    return 0;
+}
+
+/**
+ * @brief Adapts find_work to the parker_wait attempt signature, also succeeding once the executor stops.
+ *
+ * @note Used by worker_main.
+ *
+ */
+static bool attempt_find_work(void *context) {
+    // Variable declaration
+    ExecutorWorker *worker = context;
+
+    worker->found_task = find_work(worker);
+    return worker->found_task != NULL || atomic_load(&worker->executor->stopping);
+}
+
+/**
+ * @brief Takes a task from the global queue, or steals one from another worker if the global queue is empty.
+ *
+ * External submissions are preferred since no other worker can take them over from a single deque's top.
+ *
+ * @return The found task, or NULL if there is no work anywhere.
+ *
+ * @note Used by worker_main and attempt_find_work.
+ *
+ */
+static TaskNode* find_work(ExecutorWorker *worker) {
+    // Variable declaration
+    void *item;
+
+    if (queueTryDequeue(worker->executor->global_queue, &item)) {
+        return item;
+    }
+    return steal_work(worker);
+}
+
+/**
+ * @brief Tries to steal a task from the top of every other worker's deque, starting at a random victim.
+ *
+ * A random start spreads thieves over the victims instead of having all of them contend on the same deque.
+ * A steal is retried while it aborts, since an abort means another thread took a task from that deque and
+ * tasks may be left in it.
+ *
+ * @param worker The stealing worker.
+ *
+ * @return The stolen task, or NULL if all the other deques were empty.
+ *
+ * @note Used by find_work.
+ *
+ */
+static TaskNode* steal_work(ExecutorWorker *worker) {
+    // Variable declaration
+    Executor *executor = worker->executor;
+    ExecutorWorker *victim;
+    TaskNode *stolen_task;
+    StealResult result;
+    size_t start;
+    size_t i;
+
+    worker->random_state ^= worker->random_state << 13;
+    worker->random_state ^= worker->random_state >> 17;
+    worker->random_state ^= worker->random_state << 5;
+    start = worker->random_state % executor->worker_amount;
+
+    for (i = 0; i < executor->worker_amount; i++) {
+        victim = &executor->workers[(start + i) % executor->worker_amount];
+        if (victim == worker) {
+            continue;
+        }
+        while ((result = deque_steal(&victim->deque, &stolen_task)) == STEAL_ABORT) {
+            queue_cpu_relax();
+        }
+        if (result == STEAL_SUCCESS) {
+            atomic_fetch_add_explicit(&worker->stolen_tasks, 1, memory_order_relaxed);
+            return stolen_task;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs a task, recycles its node and marks it as finished.
+ *
+ * The node is recycled before the task runs so a task submitting further tasks reuses it from the worker's
+ * node cache.
+ *
+ * @param worker The worker running the task.
+ * @param task_node The task to run.
+ *
+ * @note Used by worker_main.
+ *
+ */
+static void run_task(ExecutorWorker *worker, TaskNode *task_node) {
+    // Variable declaration
+    ExecutorTask task = task_node->task;
+    void *argument = task_node->argument;
+
+    release_task_node(task_node);
+    task(argument);
+    atomic_fetch_add_explicit(&worker->executed_tasks, 1, memory_order_relaxed);
+    finish_task(worker->executor);
+}
+
+/**
+ * @brief Decrements the amount of pending tasks and wakes up executorWaitIdle callers when it drops to zero.
+ *
+ * The broadcast is sent under idle_lock, so a waiter either sees the zero before going to sleep or is
+ * already asleep when it is sent.
+ *
+ * @note Used by executorSubmit and run_task.
+ *
+ */
+static void finish_task(Executor *executor) {
+    if (atomic_fetch_sub(&executor->pending_tasks, 1) != 1) {
+        return;
+    }
+    mtx_lock(&executor->idle_lock);
+    cnd_broadcast(&executor->idle_condition);
+    mtx_unlock(&executor->idle_lock);
+}
+
+/**
+ * @brief Takes a TaskNode from the calling thread's node cache, or from the heap, and fills it.
+ *
+ * @return The new TaskNode, or NULL if memory allocation failed.
+ *
+ * @note Used by executorSubmit.
+ *
+ */
+static TaskNode* init_task_node(ExecutorTask task, void *argument) {
+    // Variable declaration
+    TaskNode *task_node;
+
+    task_node = node_cache_take(sizeof(TaskNode));
+    if (task_node == NULL) {
+        task_node = malloc(sizeof(TaskNode));
+        if (task_node == NULL) {
+            return NULL;
+        }
+    }
+    task_node->task = task;
+    task_node->argument = argument;
+    return task_node;
+}
+
+/**
+ * @brief Returns a TaskNode to the calling thread's node cache, or to the heap if the cache is full.
+ *
+ * @note Used by executorSubmit and run_task.
+ *
+ */
+static void release_task_node(TaskNode *task_node) {
+    if (!node_cache_put(task_node, sizeof(TaskNode))) {
+        free(task_node);
+    }
+}
+
+/**
+ * @brief Initializes an empty Chase-Lev deque.
+ *
+ * @return True on success, false if memory allocation failed.
+ *
+ * @note Used by init_workers.
+ *
+ */
+static bool deque_init(WorkDeque *deque) {
+    // Variable declaration
+    WorkArray *array;
+
+    array = init_work_array(DEQUE_INITIAL_CAPACITY);
+    if (array == NULL) {
+        return false;
+    }
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, array);
+    return true;
+}
+
+/**
+ * @brief Frees the current array of a deque and every array it replaced. The deque must be empty.
+ *
+ * @note Used by init_workers and destroy_executor.
+ *
+ */
+static void deque_destroy(WorkDeque *deque) {
+    // Variable declaration
+    WorkArray *array;
+    WorkArray *previous;
+
+    array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    while (array != NULL) {
+        previous = array->previous;
+        free(array);
+        array = previous;
+    }
+}
+
+/**
+ * @brief Pushes a task onto the bottom of a deque. Only the deque's owner may push.
+ *
+ * The task is written to its slot before the release fence, so a thief that reads the new bottom also
+ * reads the task.
+ *
+ * @return True on success, false if the deque was full and could not grow.
+ *
+ * @note Used by executorSubmit.
+ *
+ */
+static bool deque_push(WorkDeque *deque, TaskNode *task_node) {
+    // Variable declaration
+    WorkArray *array;
+    long bottom;
+    long top;
+
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    if (bottom - top > array->capacity - 1) {
+        array = grow_work_array(deque, array, top, bottom);
+        if (array == NULL) {
+            return false;
+        }
+    }
+
+    atomic_store_explicit(&array->slots[bottom & (array->capacity - 1)], task_node, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief Takes the task at the bottom of a deque. Only the deque's owner may take.
+ *
+ * The owner reserves the bottom slot by decrementing bottom before reading top, the seq_cst fence orders
+ * the two against the thieves' reads. Only when a single task is left the owner races the thieves for it
+ * with a compare and swap on top.
+ *
+ * @return The taken task, or NULL if the deque was empty or a thief won the last task.
+ *
+ * @note Used by worker_main.
+ *
+ */
+static TaskNode* deque_take(WorkDeque *deque) {
+    // Variable declaration
+    WorkArray *array;
+    TaskNode *task_node = NULL;
+    long bottom;
+    long top;
+
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    task_node = atomic_load_explicit(&array->slots[bottom & (array->capacity - 1)], memory_order_relaxed);
+    if (top == bottom) {
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed)) {
+            task_node = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return task_node;
+}
+
+/**
+ * @brief Steals the task at the top of a deque. Any thread may steal.
+ *
+ * @param deque The deque to steal from.
+ * @param stolen_task A pointer to the location in which to save the stolen task.
+ *
+ * @return STEAL_SUCCESS if a task was stolen, STEAL_EMPTY if the deque was empty and STEAL_ABORT if
+ * another thread took the top task first.
+ *
+ * @note Used by steal_work.
+ *
+ */
+static StealResult deque_steal(WorkDeque *deque, TaskNode **stolen_task) {
+    // Variable declaration
+    WorkArray *array;
+    TaskNode *task_node;
+    long top;
+    long bottom;
+
+    top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) {
+        return STEAL_EMPTY;
+    }
+
+    array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    task_node = atomic_load_explicit(&array->slots[top & (array->capacity - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return STEAL_ABORT;
+    }
+    *stolen_task = task_node;
+    return STEAL_SUCCESS;
+}
+
+/**
+ * @brief Allocates a deque array of the given capacity, which must be a power of two.
+ *
+ * @return The new array, or NULL if memory allocation failed.
+ *
+ * @note Used by deque_init and grow_work_array.
+ *
+ */
+static WorkArray* init_work_array(long capacity) {
+    // Variable declaration
+    WorkArray *array;
+
+    array = malloc(sizeof(WorkArray) + (size_t)capacity * sizeof(_Atomic(TaskNode*)));
+    if (array == NULL) {
+        return NULL;
+    }
+    array->capacity = capacity;
+    array->previous = NULL;
+    return array;
+}
+
+/**
+ * @brief Replaces a full deque array by one of twice its capacity holding the same tasks.
+ *
+ * The old array is kept, linked from the new one, since a thief may still read a slot of it. It is freed
+ * together with the deque.
+ *
+ * @return The new array, or NULL if memory allocation failed.
+ *
+ * @note Used by deque_push.
+ *
+ */
+static WorkArray* grow_work_array(WorkDeque *deque, WorkArray *old_array, long top, long bottom) {
+    // Variable declaration
+    WorkArray *new_array;
+    TaskNode *task_node;
+    long i;
+
+    new_array = init_work_array(old_array->capacity * 2);
+    if (new_array == NULL) {
+        return NULL;
+    }
+    for (i = top; i < bottom; i++) {
+        task_node = atomic_load_explicit(&old_array->slots[i & (old_array->capacity - 1)], memory_order_relaxed);
+        atomic_store_explicit(&new_array->slots[i & (new_array->capacity - 1)], task_node, memory_order_relaxed);
+    }
+    new_array->previous = old_array;
+    atomic_store_explicit(&deque->array, new_array, memory_order_release);
+    return new_array;
+}
+
+/* Used sources
+    1. Work stealing deque: https://www.dre.vanderbilt.edu/~schmidt/PDF/work-stealing-dequeue.pdf
+    2. Correct and efficient work stealing for weak memory models: https://fzn.fr/readings/ppopp13.pdf
+    3. Concurrency methods: https://en.cppreference.com/w/c/thread
+*/
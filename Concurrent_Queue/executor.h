@@ -0,0 +1,87 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+// Includes
+#include <stdbool.h>
+#include <stddef.h>
+#include "queue.h"
+
+// Struct defs
+typedef struct Executor Executor;
+
+typedef void (*ExecutorTask)(void *argument);
+
+typedef struct {
+    size_t executed_tasks;
+    size_t stolen_tasks;
+    size_t idle_periods;
+} ExecutorWorkerStats;
+
+/**
+ * @brief Creates a work stealing executor and starts its worker threads.
+ *
+ * Every worker owns a Chase-Lev deque for the tasks submitted by tasks it runs. Tasks submitted by other
+ * threads go through a global ConcurrentQueue. An idle worker takes work from the global queue first and
+ * then steals from the other workers' deques before going to sleep.
+ *
+ * @param worker_amount The amount of worker threads, at least 1.
+ * @param global_config The configuration of the global queue, NULL for the default configuration. Its
+ * element_size is ignored, the global queue always holds task pointers.
+ *
+ * @return A pointer to the new executor, or NULL if it could not be created.
+ */
+Executor* executorCreate(size_t worker_amount, const QueueConfig *global_config);
+
+/**
+ * @brief Submits a task to the executor.
+ *
+ * A task submitted from one of the executor's workers is pushed onto that worker's deque, otherwise it is
+ * enqueued into the global queue.
+ *
+ * @param executor The executor to run the task.
+ * @param task The function to run.
+ * @param argument The argument passed to task.
+ *
+ * @return True if the task was submitted, false if memory allocation failed or the executor is shutting
+ * down and the calling thread is not one of its workers.
+ */
+bool executorSubmit(Executor *executor, ExecutorTask task, void *argument);
+
+/**
+ * @brief Blocks until every submitted task, including tasks submitted by running tasks, has finished.
+ *
+ * Must not be called from one of the executor's workers.
+ *
+ * @param executor The executor to wait for.
+ */
+void executorWaitIdle(Executor *executor);
+
+/**
+ * @brief Stops accepting external tasks, runs the remaining ones, joins the workers and frees the executor.
+ *
+ * Must not be called from one of the executor's workers.
+ *
+ * @param executor The executor to shut down.
+ */
+void executorShutdown(Executor *executor);
+
+/**
+ * @brief Returns the amount of worker threads of the executor.
+ *
+ * @param executor The executor to query.
+ */
+size_t executorWorkerAmount(Executor *executor);
+
+/**
+ * @brief Reads the counters of one worker. The counters are updated while the executor runs, so a
+ * snapshot of several workers is not taken at a single point in time.
+ *
+ * @param executor The executor to query.
+ * @param worker_index The index of the worker, below executorWorkerAmount.
+ * @param stats A pointer to the location in which to save the counters.
+ *
+ * @return True on success, false if worker_index is out of range.
+ */
+bool executorWorkerStats(Executor *executor, size_t worker_index, ExecutorWorkerStats *stats);
+
+#endif
@@ -0,0 +1,643 @@
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+#include "futex.h"
+#include "node_pool.h"
+#include "queue_internal.h"
+#include "queue_stats.h"
+
+// Constants
+#define REQUEST_IDLE 0
+#define REQUEST_PENDING 1
+#define REQUEST_WAITING 2
+#define REQUEST_SLEEPING 3
+#define REQUEST_DONE 4
+#define OPERATION_ENQUEUE 0
+#define OPERATION_DEQUEUE 1
+#define OPERATION_TRY_DEQUEUE 2
+#define COMBINING_MAX_PASSES 4
+#define RECORD_HINT_SLOTS 4
+
+// Struct defs
+typedef struct CombiningNode {
+    struct CombiningNode *next;
+    uint64_t enqueue_time;
+    unsigned char value[];
+} CombiningNode;
+
+typedef struct PublicationRecord {
+    _Alignas(QUEUE_CACHE_LINE) atomic_uint state;
+    atomic_bool active;
+    int operation;
+    const void *values;
+    void *destination;
+    size_t amount;
+    size_t result;
+    struct PublicationRecord *next_waiter;
+    struct PublicationRecord *next;
+} PublicationRecord;
+
+typedef struct {
+    uint64_t queue_id;
+    PublicationRecord *record;
+} RecordHint;
+
+typedef struct {
+    ConcurrentQueue base;
+    _Atomic(PublicationRecord*) records;
+    uint64_t queue_id;
+    unsigned int spin_budget;
+    _Alignas(QUEUE_CACHE_LINE) mtx_t combiner_lock;
+    CombiningNode *head;
+    CombiningNode *tail;
+    size_t queue_size;
+    PublicationRecord *first_waiter;
+    PublicationRecord *last_waiter;
+    NodePool node_pool;
+    atomic_size_t visited_items;
+} FlatCombiningQueue;
+
+
+// Function declaration
+static bool flat_combining_enqueue(ConcurrentQueue*, const void*);
+static void flat_combining_dequeue(ConcurrentQueue*, void*);
+static bool flat_combining_try_dequeue(ConcurrentQueue*, void*);
+static size_t flat_combining_enqueue_batch(ConcurrentQueue*, const void*, size_t);
+static size_t flat_combining_visited(ConcurrentQueue*);
+static void flat_combining_destroy(ConcurrentQueue*);
+static bool submit_request(FlatCombiningQueue*, int, const void*, void*, size_t, size_t*);
+static void wait_for_request(FlatCombiningQueue*, PublicationRecord*);
+static void sleep_until_served(FlatCombiningQueue*, PublicationRecord*);
+static void combine(FlatCombiningQueue*);
+static bool execute_request(FlatCombiningQueue*, PublicationRecord*);
+static size_t execute_enqueue(FlatCombiningQueue*, const void*, size_t);
+static void take_head(FlatCombiningQueue*, void*);
+static void complete_request(PublicationRecord*);
+static PublicationRecord* acquire_record(FlatCombiningQueue*);
+static void release_record(PublicationRecord*);
+
+
+// Global variables declarations
+static const QueueOps flat_combining_ops = {
+    .enqueue = flat_combining_enqueue,
+    .dequeue = flat_combining_dequeue,
+    .try_dequeue = flat_combining_try_dequeue,
+    .enqueue_batch = flat_combining_enqueue_batch,
+    .visited = flat_combining_visited,
+    .destroy = flat_combining_destroy,
+};
+static atomic_uint_least64_t next_queue_id = 1;
+static _Thread_local RecordHint record_hints[RECORD_HINT_SLOTS];
+
+/*Interface methods*/
+
+/**
+ * @brief Creates a flat combining queue, a linked list whose operations are executed in batches by
+ * whichever thread holds its lock.
+ *
+ * A thread publishes its operation in a publication record of its own and then either takes the lock
+ * and becomes the combiner, executing every pending operation of every record in one pass, or spins on
+ * its record until another combiner served it. Under contention the lock is thus taken once per batch
+ * of operations instead of once per operation, and the list stays in the combiner's cache. A blocking
+ * dequeue that finds the list empty is kept in a FIFO of waiting records, and enqueues are handed
+ * directly to its head, like the thread queue of QUEUE_MODE_MUTEX.
+ *
+ * @param config The configuration of the queue. Nodes hold a value of element_size bytes and are
+ * recycled through the node pools, and a blocked dequeue spins for up to spin_budget pauses before
+ * sleeping on a futex.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ *
+ */
+ConcurrentQueue* flat_combining_queue_create(const QueueConfig *config) {
+    // Variable declaration
+    FlatCombiningQueue *queue;
+
+    queue = aligned_alloc(QUEUE_CACHE_LINE, sizeof(FlatCombiningQueue));
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    if (!node_pool_init(&queue->node_pool, sizeof(CombiningNode) + config->element_size, config->pool_prewarm,
+                        config->pool_max_retained)) {
+        free(queue);
+        return NULL;
+    }
+    if (mtx_init(&queue->combiner_lock, mtx_plain) != thrd_success) {
+        node_pool_destroy(&queue->node_pool);
+        free(queue);
+        return NULL;
+    }
+
+    queue->base.ops = &flat_combining_ops;
+    atomic_init(&queue->records, NULL);
+    queue->queue_id = atomic_fetch_add(&next_queue_id, 1);
+    queue->spin_budget = config->spin_budget;
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->queue_size = 0;
+    queue->first_waiter = NULL;
+    queue->last_waiter = NULL;
+    atomic_init(&queue->visited_items, 0);
+    return &queue->base;
+}
+
+/*Private methods*/
+
+/**
+ * @brief Publishes an enqueue and waits until a combiner executed it.
+ *
+ * @param base The queue to enqueue into.
+ * @param element_to_enqueue The value to copy into the queue.
+ *
+ * @return True if the value was enqueued, false if its node or a publication record could not be allocated.
+ *
+ * @note Used through flat_combining_ops.
+ *
+ */
+static bool flat_combining_enqueue(ConcurrentQueue *base, const void *element_to_enqueue) {
+    // Variable declaration
+    size_t enqueued_amount;
+
+    if (!submit_request((FlatCombiningQueue*)base, OPERATION_ENQUEUE, element_to_enqueue, NULL, 1, &enqueued_amount)) {
+        return false;
+    }
+    return enqueued_amount == 1;
+}
+
+/**
+ * @brief Publishes a blocking dequeue and waits until a combiner handed it a value.
+ *
+ * A publication record can only be claimed while memory is available, and a blocking dequeue has no way
+ * to report failure, so the calling thread retries until it got a record.
+ *
+ * @param base The queue to dequeue from.
+ * @param value The location in which to save the dequeued value.
+ *
+ * @note Used through flat_combining_ops.
+ *
+ */
+static void flat_combining_dequeue(ConcurrentQueue *base, void *value) {
+    while (!submit_request((FlatCombiningQueue*)base, OPERATION_DEQUEUE, NULL, value, 1, NULL)) {
+        thrd_yield();
+    }
+}
+
+/**
+ * @brief Publishes a non blocking dequeue and waits until a combiner executed it.
+ *
+ * @param base The queue to dequeue from.
+ * @param item_of_element_to_dequeue The location in which to save the dequeued value.
+ *
+ * @return True if a value was dequeued, false if the queue was empty.
+ *
+ * @note Used through flat_combining_ops.
+ *
+ */
+static bool flat_combining_try_dequeue(ConcurrentQueue *base, void *item_of_element_to_dequeue) {
+    // Variable declaration
+    size_t dequeued_amount;
+
+    if (!submit_request((FlatCombiningQueue*)base, OPERATION_TRY_DEQUEUE, NULL, item_of_element_to_dequeue, 1,
+                        &dequeued_amount)) {
+        return false;
+    }
+    return dequeued_amount == 1;
+}
+
+/**
+ * @brief Publishes a whole batch of values as a single enqueue, executed in one step by a combiner.
+ *
+ * @return The amount of values enqueued, less than amount only if a node could not be allocated.
+ *
+ * @note Used through flat_combining_ops.
+ *
+ */
+static size_t flat_combining_enqueue_batch(ConcurrentQueue *base, const void *values, size_t amount) {
+    // Variable declaration
+    size_t enqueued_amount;
+
+    if (!submit_request((FlatCombiningQueue*)base, OPERATION_ENQUEUE, values, NULL, amount, &enqueued_amount)) {
+        return 0;
+    }
+    return enqueued_amount;
+}
+
+/**
+ * @brief Returns the amount of items dequeued from the queue.
+ *
+ * @note Used through flat_combining_ops.
+ *
+ */
+static size_t flat_combining_visited(ConcurrentQueue *base) {
+    return atomic_load_explicit(&((FlatCombiningQueue*)base)->visited_items, memory_order_relaxed);
+}
+
+/**
+ * @brief Frees every node still in the queue, the publication records, the node pool, the lock and the queue.
+ *
+ * No thread may be operating on the queue while it is destroyed.
+ *
+ * @note Used through flat_combining_ops.
+ *
+ */
+static void flat_combining_destroy(ConcurrentQueue *base) {
+    // Variable declaration
+    FlatCombiningQueue *queue = (FlatCombiningQueue*)base;
+    CombiningNode *current_node;
+    CombiningNode *next_node;
+    PublicationRecord *current_record;
+    PublicationRecord *next_record;
+
+    current_node = queue->head;
+    while (current_node != NULL) {
+        next_node = current_node->next;
+        node_pool_release(&queue->node_pool, current_node);
+        current_node = next_node;
+    }
+
+    current_record = atomic_load(&queue->records);
+    while (current_record != NULL) {
+        next_record = current_record->next;
+        free(current_record);
+        current_record = next_record;
+    }
+
+    node_pool_destroy(&queue->node_pool);
+    mtx_destroy(&queue->combiner_lock);
+    free(queue);
+}
+
+/**
+ * @brief Publishes an operation in the calling thread's publication record and waits until it was executed.
+ *
+ * The arguments are written before the record's state is set to REQUEST_PENDING with a release store, so
+ * the combiner that reads the state with an acquire load sees them.
+ *
+ * @param queue The queue to operate on.
+ * @param operation One of the OPERATION constants.
+ * @param values The values to enqueue, NULL for dequeues.
+ * @param destination The location in which to save a dequeued value, NULL for enqueues.
+ * @param amount The amount of values to enqueue, 1 for dequeues.
+ * @param result The location in which to save the amount of values the operation moved, may be NULL.
+ *
+ * @return True once the operation was executed, false if no publication record could be allocated.
+ *
+ * @note Used by flat_combining_enqueue, flat_combining_dequeue, flat_combining_try_dequeue and
+ * flat_combining_enqueue_batch.
+ *
+ */
+static bool submit_request(FlatCombiningQueue *queue, int operation, const void *values, void *destination,
+                           size_t amount, size_t *result) {
+    // Variable declaration
+    PublicationRecord *record;
+
+    record = acquire_record(queue);
+    if (record == NULL) {
+        return false;
+    }
+
+    record->operation = operation;
+    record->values = values;
+    record->destination = destination;
+    record->amount = amount;
+    record->result = 0;
+    atomic_store_explicit(&record->state, REQUEST_PENDING, memory_order_release);
+
+    wait_for_request(queue, record);
+    if (result != NULL) {
+        *result = record->result;
+    }
+    atomic_store_explicit(&record->state, REQUEST_IDLE, memory_order_relaxed);
+    release_record(record);
+    return true;
+}
+
+/**
+ * @brief Waits until a published operation was executed, becoming the combiner whenever the lock is free.
+ *
+ * A pending record is served by the current combiner's next pass at the latest, so the calling thread
+ * spins on its own record, which no other thread writes until it is served, and only tries the lock when
+ * it sees it free. If the operation was a blocking dequeue parked in the FIFO of waiters, the thread
+ * sleeps until an enqueue serves it.
+ *
+ * @param queue The queue the operation was published on.
+ * @param record The calling thread's publication record.
+ *
+ * @note Used by submit_request.
+ *
+ */
+static void wait_for_request(FlatCombiningQueue *queue, PublicationRecord *record) {
+    // Variable declaration
+    unsigned int state;
+    unsigned int spins = 0;
+
+    for (;;) {
+        state = atomic_load_explicit(&record->state, memory_order_acquire);
+        if (state == REQUEST_DONE) {
+            return;
+        }
+        if (state == REQUEST_WAITING) {
+            sleep_until_served(queue, record);
+            return;
+        }
+
+        if (mtx_trylock(&queue->combiner_lock) == thrd_success) {
+            combine(queue);
+            mtx_unlock(&queue->combiner_lock);
+            continue;
+        }
+        queue_cpu_relax();
+        if (++spins % QUEUE_SPIN_YIELD_INTERVAL == 0) {
+            thrd_yield();
+        }
+    }
+}
+
+/**
+ * @brief Spins for up to the queue's spin budget, then sleeps on the record's state until an enqueue
+ * served the waiting dequeue.
+ *
+ * The state is moved from REQUEST_WAITING to REQUEST_SLEEPING before sleeping, which tells the serving
+ * combiner to issue a futex wake. If the compare and swap fails the record was served in the meantime.
+ * A sleeping thread is counted as parked in the statistics.
+ *
+ * @param queue The queue whose spin budget to use.
+ * @param record The calling thread's publication record, in the FIFO of waiters.
+ *
+ * @note Used by wait_for_request.
+ *
+ */
+static void sleep_until_served(FlatCombiningQueue *queue, PublicationRecord *record) {
+    // Variable declaration
+    unsigned int spins;
+    unsigned int expected_state = REQUEST_WAITING;
+
+    for (spins = 0; spins < queue->spin_budget; spins++) {
+        if (atomic_load_explicit(&record->state, memory_order_acquire) == REQUEST_DONE) {
+            return;
+        }
+        queue_cpu_relax();
+    }
+
+    if (!atomic_compare_exchange_strong_explicit(&record->state, &expected_state, REQUEST_SLEEPING,
+                                                 memory_order_acquire, memory_order_acquire)) {
+        return;
+    }
+    queue_stats_parked(queue->base.stats, 1);
+    while (atomic_load_explicit(&record->state, memory_order_acquire) != REQUEST_DONE) {
+        futex_wait(&record->state, REQUEST_SLEEPING);
+    }
+    queue_stats_parked(queue->base.stats, -1);
+}
+
+/**
+ * @brief Executes the pending operations of every publication record, pass after pass, until a pass finds
+ * nothing to do or COMBINING_MAX_PASSES passes were made.
+ *
+ * Bounding the passes keeps a combiner from serving other threads forever while its own operation is
+ * long done.
+ *
+ * @param queue The queue to combine on, its lock must be held by the caller.
+ *
+ * @note Used by wait_for_request.
+ *
+ */
+static void combine(FlatCombiningQueue *queue) {
+    // Variable declaration
+    PublicationRecord *current_record;
+    bool executed;
+    int pass;
+
+    for (pass = 0; pass < COMBINING_MAX_PASSES; pass++) {
+        executed = false;
+        for (current_record = atomic_load_explicit(&queue->records, memory_order_acquire); current_record != NULL;
+             current_record = current_record->next) {
+            if (atomic_load_explicit(&current_record->state, memory_order_acquire) == REQUEST_PENDING) {
+                executed |= execute_request(queue, current_record);
+            }
+        }
+        if (!executed) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Executes one pending operation against the list.
+ *
+ * A blocking dequeue that finds the list empty is appended to the FIFO of waiters and its record moved
+ * to REQUEST_WAITING, so later passes skip it until an enqueue serves it.
+ *
+ * @param queue The queue to operate on, its lock must be held by the caller.
+ * @param record A publication record in REQUEST_PENDING.
+ *
+ * @return True, the record was either served or parked.
+ *
+ * @note Used by combine.
+ *
+ */
+static bool execute_request(FlatCombiningQueue *queue, PublicationRecord *record) {
+    switch (record->operation) {
+        case OPERATION_ENQUEUE:
+            record->result = execute_enqueue(queue, record->values, record->amount);
+            break;
+
+        case OPERATION_TRY_DEQUEUE:
+            if (queue->queue_size > 0) {
+                take_head(queue, record->destination);
+                record->result = 1;
+            }
+            break;
+
+        default:
+            if (queue->queue_size == 0) {
+                record->next_waiter = NULL;
+                if (queue->first_waiter == NULL) {
+                    queue->first_waiter = record;
+                }
+                else {
+                    queue->last_waiter->next_waiter = record;
+                }
+                queue->last_waiter = record;
+                atomic_store_explicit(&record->state, REQUEST_WAITING, memory_order_release);
+                return true;
+            }
+            take_head(queue, record->destination);
+            record->result = 1;
+            break;
+    }
+    complete_request(record);
+    return true;
+}
+
+/**
+ * @brief Hands values to waiting dequeues in FIFO order and appends the rest to the tail of the list.
+ *
+ * A handed value never enters the list, so every value in it is free to take. A handed value counts as
+ * visited at once, and if it is sampled its sojourn time is the time it takes to hand it over.
+ *
+ * @param queue The queue to enqueue into, its lock must be held by the caller.
+ * @param values The values to enqueue.
+ * @param amount The amount of values.
+ *
+ * @return The amount of values enqueued, less than amount only if a node could not be allocated.
+ *
+ * @note Used by execute_request.
+ *
+ */
+static size_t execute_enqueue(FlatCombiningQueue *queue, const void *values, size_t amount) {
+    // Variable declaration
+    const unsigned char *value_bytes = values;
+    size_t element_size = queue->base.element_size;
+    PublicationRecord *served_record;
+    CombiningNode *new_node;
+    size_t enqueued_amount = 0;
+
+    while (enqueued_amount < amount && queue->first_waiter != NULL) {
+        served_record = queue->first_waiter;
+        queue->first_waiter = served_record->next_waiter;
+        queue_copy_value(served_record->destination, value_bytes + enqueued_amount * element_size, element_size);
+        served_record->result = 1;
+        atomic_fetch_add_explicit(&queue->visited_items, 1, memory_order_relaxed);
+        queue_stats_record_sojourn(queue->base.stats, queue_stats_sample_time(queue->base.stats));
+        complete_request(served_record);
+        enqueued_amount++;
+    }
+
+    for (; enqueued_amount < amount; enqueued_amount++) {
+        new_node = node_cache_take(queue->node_pool.node_size);
+        if (new_node == NULL) {
+            new_node = node_pool_alloc(&queue->node_pool);
+            if (new_node == NULL) {
+                break;
+            }
+        }
+        queue_copy_value(new_node->value, value_bytes + enqueued_amount * element_size, element_size);
+        new_node->enqueue_time = queue_stats_sample_time(queue->base.stats);
+        new_node->next = NULL;
+        if (queue->tail == NULL) {
+            queue->head = new_node;
+        }
+        else {
+            queue->tail->next = new_node;
+        }
+        queue->tail = new_node;
+        queue->queue_size++;
+    }
+    queue_stats_record_depth(queue->base.stats, queue->queue_size);
+    return enqueued_amount;
+}
+
+/**
+ * @brief Unlinks the head node of a non empty list, copies out its value and recycles the node.
+ *
+ * @param queue The queue to dequeue from, its lock must be held by the caller.
+ * @param destination The location in which to save the value.
+ *
+ * @note Used by execute_request.
+ *
+ */
+static void take_head(FlatCombiningQueue *queue, void *destination) {
+    // Variable declaration
+    CombiningNode *head = queue->head;
+
+    queue->head = head->next;
+    if (queue->head == NULL) {
+        queue->tail = NULL;
+    }
+    queue->queue_size--;
+    queue_copy_value(destination, head->value, queue->base.element_size);
+    atomic_fetch_add_explicit(&queue->visited_items, 1, memory_order_relaxed);
+    queue_stats_record_sojourn(queue->base.stats, head->enqueue_time);
+    node_pool_release(&queue->node_pool, head);
+}
+
+/**
+ * @brief Marks a record as served, waking up its thread if it sleeps on the record.
+ *
+ * The release exchange publishes the result and any value copied for the thread. Once the state is
+ * REQUEST_DONE the thread may return and reuse the record, so it is not touched afterwards except for the
+ * futex wake, which at worst causes a spurious wake up that every futex waiter re-checks anyway.
+ *
+ * @param record The record to complete.
+ *
+ * @note Used by execute_request and execute_enqueue.
+ *
+ */
+static void complete_request(PublicationRecord *record) {
+    if (atomic_exchange_explicit(&record->state, REQUEST_DONE, memory_order_release) == REQUEST_SLEEPING) {
+        futex_wake(&record->state, 1);
+    }
+}
+
+/**
+ * @brief Claims a publication record of the queue for the duration of one operation.
+ *
+ * As for the hazard records of QUEUE_MODE_LOCK_FREE, the record the calling thread used last on this
+ * queue is tried first, then the record list is scanned for an inactive record, and if all are taken a
+ * new record is pushed onto it. Records are never removed before the queue is destroyed, and each starts
+ * on its own cache line so threads spinning on their records do not false share.
+ *
+ * @param queue The queue whose record to claim.
+ *
+ * @return The claimed record, or NULL if a new record could not be allocated.
+ *
+ * @note Used by submit_request.
+ *
+ */
+static PublicationRecord* acquire_record(FlatCombiningQueue *queue) {
+    // Variable declaration
+    RecordHint *hint = &record_hints[queue->queue_id % RECORD_HINT_SLOTS];
+    PublicationRecord *current_record;
+    bool expected;
+
+    if (hint->queue_id == queue->queue_id) {
+        expected = false;
+        if (atomic_compare_exchange_strong(&hint->record->active, &expected, true)) {
+            return hint->record;
+        }
+    }
+
+    for (current_record = atomic_load(&queue->records); current_record != NULL; current_record = current_record->next) {
+        expected = false;
+        if (atomic_compare_exchange_strong(&current_record->active, &expected, true)) {
+            hint->queue_id = queue->queue_id;
+            hint->record = current_record;
+            return current_record;
+        }
+    }
+
+    current_record = aligned_alloc(QUEUE_CACHE_LINE, sizeof(PublicationRecord));
+    if (current_record == NULL) {
+        return NULL;
+    }
+    atomic_init(&current_record->state, REQUEST_IDLE);
+    atomic_init(&current_record->active, true);
+    current_record->next_waiter = NULL;
+    current_record->next = atomic_load(&queue->records);
+    while (!atomic_compare_exchange_weak(&queue->records, &current_record->next, current_record)) {
+    }
+
+    hint->queue_id = queue->queue_id;
+    hint->record = current_record;
+    return current_record;
+}
+
+/**
+ * @brief Makes a publication record available to other threads.
+ *
+ * @note Used by submit_request.
+ *
+ */
+static void release_record(PublicationRecord *record) {
+    atomic_store_explicit(&record->active, false, memory_order_release);
+}
+
+/* Used sources
+    1. Flat combining: https://people.csail.mit.edu/shanir/publications/Flat%20Combining%20SPAA%2010.pdf
+    2. Futex: https://man7.org/linux/man-pages/man2/futex.2.html
+*/
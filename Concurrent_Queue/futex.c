@@ -0,0 +1,71 @@
+// Includes
+#define _GNU_SOURCE
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "futex.h"
+#include "queue_trace.h"
+
+/*Interface methods*/
+
+/**
+ * @brief Sleeps on a Linux futex word as long as it holds the expected value.
+ *
+ * The kernel compares the word with expected and puts the thread to sleep atomically, so a wake issued
+ * after the word was changed can not be missed. The private variant is used since the words never leave
+ * the process, which lets the kernel skip the shared mapping lookup.
+ *
+ * @param word The futex word to sleep on.
+ * @param expected The value the word has to hold for the thread to go to sleep.
+ *
+ */
+void futex_wait(atomic_uint *word, unsigned int expected) {
+    // Variable declaration
+    uint64_t trace_start = queue_trace_begin();
+
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+    queue_trace_end(QUEUE_TRACE_PARK, word, trace_start);
+}
+
+/**
+ * @brief Wakes up to amount threads sleeping on a futex word.
+ *
+ * @param word The futex word to wake threads from.
+ * @param amount The maximal amount of threads to wake.
+ *
+ */
+void futex_wake(atomic_uint *word, int amount) {
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE_PRIVATE, amount, NULL, NULL, 0);
+    queue_trace_instant(QUEUE_TRACE_WAKE, word, 1);
+}
+
+/**
+ * @brief Sleeps on a futex word placed in memory shared between processes.
+ *
+ * Same as futex_wait, but the kernel keys the word by its backing page, so threads of other processes
+ * that mapped the same page can wake the thread up.
+ *
+ * @param word The futex word to sleep on.
+ * @param expected The value the word has to hold for the thread to go to sleep.
+ *
+ */
+void futex_wait_shared(atomic_uint *word, unsigned int expected) {
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+/**
+ * @brief Wakes up to amount threads, of any process, sleeping on a futex word in shared memory.
+ *
+ * @param word The futex word to wake threads from.
+ * @param amount The maximal amount of threads to wake.
+ *
+ */
+void futex_wake_shared(atomic_uint *word, int amount) {
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, amount, NULL, NULL, 0);
+}
+
+/* Used sources
+    1. Futex system call: https://man7.org/linux/man-pages/man2/futex.2.html
+*/
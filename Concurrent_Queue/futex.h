@@ -0,0 +1,42 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+// Includes
+#include <stdatomic.h>
+
+/**
+ * @brief Sleeps on a Linux futex word as long as it holds the expected value.
+ *
+ * Returns at once if the word no longer holds expected, and may return spuriously, so callers re-check
+ * the word in a loop.
+ *
+ * @param word The futex word to sleep on.
+ * @param expected The value the word has to hold for the thread to go to sleep.
+ */
+void futex_wait(atomic_uint *word, unsigned int expected);
+
+/**
+ * @brief Wakes up to amount threads sleeping on a futex word.
+ *
+ * @param word The futex word to wake threads from.
+ * @param amount The maximal amount of threads to wake.
+ */
+void futex_wake(atomic_uint *word, int amount);
+
+/**
+ * @brief Sleeps on a futex word in memory shared between processes, as long as it holds the expected value.
+ *
+ * @param word The futex word to sleep on, inside a MAP_SHARED mapping.
+ * @param expected The value the word has to hold for the thread to go to sleep.
+ */
+void futex_wait_shared(atomic_uint *word, unsigned int expected);
+
+/**
+ * @brief Wakes up to amount threads, of any process, sleeping on a futex word in shared memory.
+ *
+ * @param word The futex word to wake threads from.
+ * @param amount The maximal amount of threads to wake.
+ */
+void futex_wake_shared(atomic_uint *word, int amount);
+
+#endif
@@ -0,0 +1,705 @@
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+#include "node_pool.h"
+#include "parker.h"
+#include "queue_internal.h"
+#include "queue_stats.h"
+
+// Constants
+#define HAZARDS_PER_THREAD 2
+#define RETIRED_SCAN_THRESHOLD 64
+#define RECORD_HINT_SLOTS 4
+
+// Struct defs
+typedef struct LockFreeNode {
+    _Atomic(struct LockFreeNode*) next;
+    uint64_t enqueue_time;
+    struct LockFreeNode *retired_next;
+    unsigned char value[];
+} LockFreeNode;
+
+typedef struct HazardRecord {
+    _Atomic(void*) hazards[HAZARDS_PER_THREAD];
+    atomic_bool active;
+    LockFreeNode *retired;
+    size_t retired_count;
+    struct HazardRecord *next;
+} HazardRecord;
+
+typedef struct {
+    uint64_t queue_id;
+    HazardRecord *record;
+} RecordHint;
+
+typedef struct {
+    ConcurrentQueue base;
+    _Alignas(QUEUE_CACHE_LINE) _Atomic(LockFreeNode*) head;
+    _Alignas(QUEUE_CACHE_LINE) _Atomic(LockFreeNode*) tail;
+    _Alignas(QUEUE_CACHE_LINE) _Atomic(LockFreeNode*) free_nodes;
+    atomic_size_t free_count;
+    size_t max_retained;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t visited_items;
+    _Atomic(HazardRecord*) records;
+    atomic_size_t record_amount;
+    uint64_t queue_id;
+    size_t node_size;
+    Parker parker;
+} LockFreeQueue;
+
+typedef struct {
+    LockFreeQueue *queue;
+    void *value;
+} DequeueAttempt;
+
+
+// Function declaration
+static bool lock_free_enqueue(ConcurrentQueue*, const void*);
+static void lock_free_dequeue(ConcurrentQueue*, void*);
+static bool lock_free_try_dequeue(ConcurrentQueue*, void*);
+static size_t lock_free_visited(ConcurrentQueue*);
+static void lock_free_destroy(ConcurrentQueue*);
+static bool attempt_dequeue(void*);
+static LockFreeNode* init_node(LockFreeQueue*, HazardRecord*, const void*);
+static LockFreeNode* pop_free_node(LockFreeQueue*, HazardRecord*);
+static HazardRecord* acquire_record(LockFreeQueue*);
+static void release_record(HazardRecord*);
+static void* protect(HazardRecord*, int, _Atomic(LockFreeNode*)*);
+static void retire_node(LockFreeQueue*, HazardRecord*, LockFreeNode*);
+static void scan_retired_nodes(LockFreeQueue*, HazardRecord*);
+static bool is_hazardous(void**, size_t, void*);
+static void free_node(LockFreeQueue*, LockFreeNode*);
+static void free_node_list(LockFreeQueue*);
+
+
+// Global variables declarations
+static const QueueOps lock_free_ops = {
+    .enqueue = lock_free_enqueue,
+    .dequeue = lock_free_dequeue,
+    .try_dequeue = lock_free_try_dequeue,
+    .visited = lock_free_visited,
+    .destroy = lock_free_destroy,
+};
+static atomic_uint_least64_t next_queue_id = 1;
+static _Thread_local RecordHint record_hints[RECORD_HINT_SLOTS];
+
+/*Interface methods*/
+
+/**
+ * @brief Creates a Michael-Scott lock free queue with hazard pointer based node reclamation.
+ *
+ * The queue always holds a dummy node, head points at it and the first item lives in its successor.
+ * Hazard records are created lazily, one per thread concurrently operating on the queue.
+ *
+ * @param config The configuration of the queue. Every node holds a value of element_size bytes, the queue's
+ * free list is prewarmed with pool_prewarm nodes and keeps at most pool_max_retained.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ *
+ */
+ConcurrentQueue* lock_free_queue_create(const QueueConfig *config) {
+    // Variable declaration
+    LockFreeQueue *queue;
+    LockFreeNode *dummy;
+    LockFreeNode *new_node;
+    size_t prewarm;
+
+    queue = aligned_alloc(QUEUE_CACHE_LINE, sizeof(LockFreeQueue));
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    queue->node_size = sizeof(LockFreeNode) + config->element_size;
+    queue->max_retained = config->pool_max_retained;
+    atomic_init(&queue->free_nodes, NULL);
+    atomic_init(&queue->free_count, 0);
+    prewarm = config->pool_prewarm < config->pool_max_retained ? config->pool_prewarm : config->pool_max_retained;
+    while (atomic_load_explicit(&queue->free_count, memory_order_relaxed) < prewarm) {
+        new_node = malloc(queue->node_size);
+        if (new_node == NULL) {
+            free_node_list(queue);
+            free(queue);
+            return NULL;
+        }
+        atomic_init(&new_node->next, atomic_load_explicit(&queue->free_nodes, memory_order_relaxed));
+        atomic_store_explicit(&queue->free_nodes, new_node, memory_order_relaxed);
+        atomic_fetch_add_explicit(&queue->free_count, 1, memory_order_relaxed);
+    }
+
+    dummy = init_node(queue, NULL, NULL);
+    if (dummy == NULL) {
+        free_node_list(queue);
+        free(queue);
+        return NULL;
+    }
+    if (!parker_init(&queue->parker)) {
+        free(dummy);
+        free_node_list(queue);
+        free(queue);
+        return NULL;
+    }
+
+    queue->base.ops = &lock_free_ops;
+    atomic_init(&queue->head, dummy);
+    atomic_init(&queue->tail, dummy);
+    atomic_init(&queue->visited_items, 0);
+    atomic_init(&queue->records, NULL);
+    atomic_init(&queue->record_amount, 0);
+    queue->queue_id = atomic_fetch_add(&next_queue_id, 1);
+    return &queue->base;
+}
+
+/*Private methods*/
+
+/**
+ * @brief Links a new node after the current tail and wakes up a parked consumer if one exists.
+ *
+ * The tail is protected by a hazard pointer so its node cannot be reclaimed while its next field is CASed.
+ * A lagging tail is helped forward before retrying, which keeps the queue lock free.
+ * The queue does not know its own depth, so it is only offered as high water mark on enqueues sampled for
+ * the sojourn histogram.
+ *
+ * @param base The queue to enqueue into.
+ * @param element_to_enqueue The value to copy into the new node.
+ *
+ * @return True if the value was enqueued, false if its node could not be allocated.
+ *
+ * @note Used through lock_free_ops.
+ *
+ */
+static bool lock_free_enqueue(ConcurrentQueue *base, const void *element_to_enqueue) {
+    // Variable declaration
+    LockFreeQueue *queue = (LockFreeQueue*)base;
+    LockFreeNode *new_node;
+    LockFreeNode *tail;
+    LockFreeNode *next;
+    LockFreeNode *expected;
+    HazardRecord *record;
+    uint64_t enqueue_time;
+
+    record = acquire_record(queue);
+    if (record == NULL) {
+        return false;
+    }
+    new_node = init_node(queue, record, element_to_enqueue);
+    if (new_node == NULL) {
+        release_record(record);
+        return false;
+    }
+    enqueue_time = queue_stats_sample_time(base->stats);
+    new_node->enqueue_time = enqueue_time;
+
+    for (;;) {
+        tail = protect(record, 0, &queue->tail);
+        next = atomic_load(&tail->next);
+        if (tail != atomic_load(&queue->tail)) {
+            continue;
+        }
+
+        if (next != NULL) {
+            atomic_compare_exchange_weak(&queue->tail, &tail, next);
+            continue;
+        }
+
+        expected = NULL;
+        if (atomic_compare_exchange_weak(&tail->next, &expected, new_node)) {
+            break;
+        }
+    }
+    atomic_compare_exchange_strong(&queue->tail, &tail, new_node);
+
+    release_record(record);
+    // Once linked the node may be dequeued and reclaimed at any time, so it is not read again
+    if (enqueue_time != 0) {
+        queue_stats_record_depth(base->stats, queue_stats_depth(base->stats));
+    }
+    parker_wake(&queue->parker);
+    return true;
+}
+
+/**
+ * @brief Dequeues an item, parking the calling thread only while the queue is truly empty.
+ *
+ * A thread whose first attempt failed is counted as parked in the statistics until it got its item.
+ *
+ * @param base The queue to dequeue from.
+ * @param value The location in which to save the dequeued value.
+ *
+ * @note Used through lock_free_ops.
+ *
+ */
+static void lock_free_dequeue(ConcurrentQueue *base, void *value) {
+    // Variable declaration
+    DequeueAttempt attempt;
+
+    attempt.queue = (LockFreeQueue*)base;
+    attempt.value = value;
+    if (!attempt_dequeue(&attempt)) {
+        queue_stats_parked(base->stats, 1);
+        parker_wait(&attempt.queue->parker, attempt_dequeue, &attempt);
+        queue_stats_parked(base->stats, -1);
+    }
+}
+
+/**
+ * @brief Tries to unlink the node following the dummy head and copies out its value.
+ *
+ * Both the head and its successor are protected by hazard pointers. The value is copied after the head
+ * CAS: the successor becomes the new dummy and may be dequeued by another thread, but its hazard pointer
+ * keeps it from being reclaimed and its value is never written again, so the caller's location is only
+ * written once the item is really taken. The old dummy is retired instead of freed since other threads
+ * may still read it.
+ *
+ * @param base The queue to dequeue from.
+ * @param item_of_element_to_dequeue The location in which to save the dequeued value.
+ *
+ * @return True if an item was dequeued, false if the queue was empty.
+ *
+ * @note Used through lock_free_ops and by attempt_dequeue.
+ *
+ */
+static bool lock_free_try_dequeue(ConcurrentQueue *base, void *item_of_element_to_dequeue) {
+    // Variable declaration
+    LockFreeQueue *queue = (LockFreeQueue*)base;
+    LockFreeNode *head;
+    LockFreeNode *tail;
+    LockFreeNode *next;
+    HazardRecord *record;
+
+    record = acquire_record(queue);
+    if (record == NULL) {
+        return false;
+    }
+
+    for (;;) {
+        head = protect(record, 0, &queue->head);
+        tail = atomic_load(&queue->tail);
+        next = protect(record, 1, &head->next);
+        if (head != atomic_load(&queue->head)) {
+            continue;
+        }
+
+        if (next == NULL) {
+            release_record(record);
+            return false;
+        }
+
+        if (head == tail) {
+            atomic_compare_exchange_weak(&queue->tail, &tail, next);
+            continue;
+        }
+
+        if (atomic_compare_exchange_weak(&queue->head, &head, next)) {
+            break;
+        }
+    }
+
+    queue_copy_value(item_of_element_to_dequeue, next->value, base->element_size);
+    queue_stats_record_sojourn(base->stats, next->enqueue_time);
+    atomic_fetch_add_explicit(&queue->visited_items, 1, memory_order_relaxed);
+    retire_node(queue, record, head);
+    release_record(record);
+    return true;
+}
+
+/**
+ * @brief Returns the amount of items dequeued from the queue.
+ *
+ * @note Used through lock_free_ops.
+ *
+ */
+static size_t lock_free_visited(ConcurrentQueue *base) {
+    return atomic_load_explicit(&((LockFreeQueue*)base)->visited_items, memory_order_relaxed);
+}
+
+/**
+ * @brief Frees every node still linked in the queue, every retired or free node and every hazard record.
+ *
+ * No thread may be operating on the queue while it is destroyed.
+ *
+ * @note Used through lock_free_ops.
+ *
+ */
+static void lock_free_destroy(ConcurrentQueue *base) {
+    // Variable declaration
+    LockFreeQueue *queue = (LockFreeQueue*)base;
+    LockFreeNode *current_node;
+    LockFreeNode *next_node;
+    HazardRecord *current_record;
+    HazardRecord *next_record;
+
+    current_node = atomic_load(&queue->head);
+    while (current_node != NULL) {
+        next_node = atomic_load(&current_node->next);
+        free_node(queue, current_node);
+        current_node = next_node;
+    }
+
+    current_record = atomic_load(&queue->records);
+    while (current_record != NULL) {
+        next_record = current_record->next;
+        current_node = current_record->retired;
+        while (current_node != NULL) {
+            next_node = current_node->retired_next;
+            free_node(queue, current_node);
+            current_node = next_node;
+        }
+        free(current_record);
+        current_record = next_record;
+    }
+
+    free_node_list(queue);
+    parker_destroy(&queue->parker);
+    free(queue);
+}
+
+/**
+ * @brief Adapts lock_free_try_dequeue to the parker_wait attempt signature.
+ *
+ * @param context A pointer to a DequeueAttempt.
+ *
+ * @note Used by lock_free_dequeue.
+ *
+ */
+static bool attempt_dequeue(void *context) {
+    // Variable declaration
+    DequeueAttempt *attempt = context;
+
+    return lock_free_try_dequeue(&attempt->queue->base, attempt->value);
+}
+
+/**
+ * @brief Takes a node from the calling thread's cache, the queue's free list or the heap, and copies a value
+ * into it.
+ *
+ * The initial dummy node is created without a value and without a record, before any other thread can
+ * reach the queue, so it skips the free list.
+ *
+ * @param queue The queue to allocate from.
+ * @param record The calling thread's hazard record, NULL for the dummy.
+ * @param element_to_enqueue The value of the node, NULL for the dummy.
+ *
+ * @return The new node, or NULL if memory allocation failed.
+ *
+ * @note Used by lock_free_queue_create and lock_free_enqueue.
+ *
+ */
+static LockFreeNode* init_node(LockFreeQueue *queue, HazardRecord *record, const void *element_to_enqueue) {
+    // Variable declaration
+    LockFreeNode *new_node;
+
+    new_node = node_cache_take(queue->node_size);
+    if (new_node == NULL && record != NULL) {
+        new_node = pop_free_node(queue, record);
+    }
+    if (new_node == NULL) {
+        new_node = malloc(queue->node_size);
+        if (new_node == NULL) {
+            return NULL;
+        }
+    }
+    atomic_init(&new_node->next, NULL);
+    if (element_to_enqueue != NULL) {
+        queue_copy_value(new_node->value, element_to_enqueue, queue->base.element_size);
+    }
+    new_node->enqueue_time = 0;
+    return new_node;
+}
+
+/**
+ * @brief Pops a node off the queue's free list, a Treiber stack linked through the nodes' next fields.
+ *
+ * The top is protected by the second hazard pointer of the record before its successor is read. A node
+ * only returns to the free list through scan_retired_nodes, which skips protected nodes, so while the
+ * hazard pointer is published the top can neither be pushed again (the ABA problem of a plain Treiber
+ * stack) nor be returned to the heap, and the CAS only succeeds if the successor read is still current.
+ *
+ * @param queue The queue whose free list to pop.
+ * @param record The calling thread's hazard record.
+ *
+ * @return The popped node, or NULL if the free list is empty.
+ *
+ * @note Used by init_node.
+ *
+ */
+static LockFreeNode* pop_free_node(LockFreeQueue *queue, HazardRecord *record) {
+    // Variable declaration
+    LockFreeNode *top;
+    LockFreeNode *next;
+
+    for (;;) {
+        top = protect(record, 1, &queue->free_nodes);
+        if (top == NULL) {
+            return NULL;
+        }
+        next = atomic_load_explicit(&top->next, memory_order_relaxed);
+        if (atomic_compare_exchange_weak(&queue->free_nodes, &top, next)) {
+            atomic_fetch_sub_explicit(&queue->free_count, 1, memory_order_relaxed);
+            return top;
+        }
+    }
+}
+
+/**
+ * @brief Claims a hazard record of the queue for the duration of one operation.
+ *
+ * The record the calling thread used last on this queue is tried first, so in the steady state claiming
+ * costs one uncontended CAS. Otherwise the record list is scanned for an inactive record, and if all are
+ * taken a new record is pushed onto it. Records are never removed before the queue is destroyed, and a
+ * released record keeps its retired nodes for the next thread claiming it.
+ *
+ * @param queue The queue whose record to claim.
+ *
+ * @return The claimed record, or NULL if a new record could not be allocated.
+ *
+ * @note Used by lock_free_enqueue and lock_free_try_dequeue.
+ *
+ */
+static HazardRecord* acquire_record(LockFreeQueue *queue) {
+    // Variable declaration
+    RecordHint *hint = &record_hints[queue->queue_id % RECORD_HINT_SLOTS];
+    HazardRecord *current_record;
+    bool expected;
+    int i;
+
+    if (hint->queue_id == queue->queue_id) {
+        expected = false;
+        if (atomic_compare_exchange_strong(&hint->record->active, &expected, true)) {
+            return hint->record;
+        }
+    }
+
+    for (current_record = atomic_load(&queue->records); current_record != NULL; current_record = current_record->next) {
+        expected = false;
+        if (atomic_compare_exchange_strong(&current_record->active, &expected, true)) {
+            hint->queue_id = queue->queue_id;
+            hint->record = current_record;
+            return current_record;
+        }
+    }
+
+    current_record = malloc(sizeof(HazardRecord));
+    if (current_record == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < HAZARDS_PER_THREAD; i++) {
+        atomic_init(&current_record->hazards[i], NULL);
+    }
+    atomic_init(&current_record->active, true);
+    current_record->retired = NULL;
+    current_record->retired_count = 0;
+    current_record->next = atomic_load(&queue->records);
+    while (!atomic_compare_exchange_weak(&queue->records, &current_record->next, current_record)) {
+    }
+    atomic_fetch_add(&queue->record_amount, 1);
+
+    hint->queue_id = queue->queue_id;
+    hint->record = current_record;
+    return current_record;
+}
+
+/**
+ * @brief Clears the hazard pointers of a record and makes it available to other threads.
+ *
+ * @note Used by lock_free_enqueue and lock_free_try_dequeue.
+ *
+ */
+static void release_record(HazardRecord *record) {
+    // Variable declaration
+    int i;
+
+    for (i = 0; i < HAZARDS_PER_THREAD; i++) {
+        atomic_store_explicit(&record->hazards[i], NULL, memory_order_release);
+    }
+    atomic_store_explicit(&record->active, false, memory_order_release);
+}
+
+/**
+ * @brief Publishes the value of an atomic node pointer in a hazard slot until the published value is stable.
+ *
+ * Once the source still holds the published pointer after publishing it, the node cannot have been retired
+ * before the publication and any later scan will see it.
+ *
+ * @param record The calling thread's hazard record.
+ * @param slot The hazard slot to publish in.
+ * @param source The atomic pointer to protect.
+ *
+ * @return The protected pointer.
+ *
+ * @note Used by lock_free_enqueue, lock_free_try_dequeue and pop_free_node.
+ *
+ */
+static void* protect(HazardRecord *record, int slot, _Atomic(LockFreeNode*) *source) {
+    // Variable declaration
+    LockFreeNode *protected_node;
+    LockFreeNode *current_node;
+
+    current_node = atomic_load(source);
+    do {
+        protected_node = current_node;
+        atomic_store(&record->hazards[slot], protected_node);
+        current_node = atomic_load(source);
+    } while (current_node != protected_node);
+    return protected_node;
+}
+
+/**
+ * @brief Adds a dequeued dummy node to the record's retired list, scanning the list once it grew large enough.
+ *
+ * The list is linked through retired_next rather than next, since a thread still holding a stale tail may
+ * CAS the next field of the retired node and must keep failing. The threshold grows with the amount of
+ * records so a scan always frees a constant fraction of the list.
+ *
+ * @note Used by lock_free_try_dequeue.
+ *
+ */
+static void retire_node(LockFreeQueue *queue, HazardRecord *record, LockFreeNode *node) {
+    // Variable declaration
+    size_t threshold;
+
+    node->retired_next = record->retired;
+    record->retired = node;
+    record->retired_count++;
+
+    threshold = RETIRED_SCAN_THRESHOLD + 2 * HAZARDS_PER_THREAD * atomic_load(&queue->record_amount);
+    if (record->retired_count >= threshold) {
+        scan_retired_nodes(queue, record);
+    }
+}
+
+/**
+ * @brief Frees every retired node of the record that no hazard pointer of any record protects.
+ *
+ * Only records already linked when the scan starts are inspected. Records are pushed at the head of the
+ * list, and a thread using a younger record published its hazards after every node on the retired list
+ * was unlinked, so its validation in protect can never succeed for them.
+ *
+ * @note Used by retire_node.
+ *
+ */
+static void scan_retired_nodes(LockFreeQueue *queue, HazardRecord *record) {
+    // Variable declaration
+    void **hazards;
+    size_t hazard_amount = 0;
+    size_t capacity = 0;
+    int i;
+    HazardRecord *first_record;
+    HazardRecord *current_record;
+    LockFreeNode *current_node;
+    LockFreeNode *next_node;
+    LockFreeNode *still_retired = NULL;
+    size_t still_retired_count = 0;
+
+    first_record = atomic_load(&queue->records);
+    for (current_record = first_record; current_record != NULL; current_record = current_record->next) {
+        capacity += HAZARDS_PER_THREAD;
+    }
+    hazards = malloc(capacity * sizeof(void*));
+    if (hazards == NULL) {
+        return;
+    }
+
+    for (current_record = first_record; current_record != NULL; current_record = current_record->next) {
+        for (i = 0; i < HAZARDS_PER_THREAD; i++) {
+            hazards[hazard_amount] = atomic_load(&current_record->hazards[i]);
+            if (hazards[hazard_amount] != NULL) {
+                hazard_amount++;
+            }
+        }
+    }
+
+    current_node = record->retired;
+    while (current_node != NULL) {
+        next_node = current_node->retired_next;
+        if (is_hazardous(hazards, hazard_amount, current_node)) {
+            current_node->retired_next = still_retired;
+            still_retired = current_node;
+            still_retired_count++;
+        }
+        else {
+            free_node(queue, current_node);
+        }
+        current_node = next_node;
+    }
+
+    record->retired = still_retired;
+    record->retired_count = still_retired_count;
+    free(hazards);
+}
+
+/**
+ * @brief Checks whether a node is in the snapshot of hazard pointers.
+ *
+ * @note Used by scan_retired_nodes.
+ *
+ */
+static bool is_hazardous(void **hazards, size_t hazard_amount, void *node) {
+    // Variable declaration
+    size_t i;
+
+    for (i = 0; i < hazard_amount; i++) {
+        if (hazards[i] == node) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Returns a node to the calling thread's cache, the queue's free list, or the heap, whichever has room
+ * first.
+ *
+ * A push needs no hazard pointer, the CAS only compares the top it linked the node to. The free count is
+ * claimed before the push, so the list never holds more than max_retained nodes.
+ *
+ * @note Used by the reclamation and destruction paths.
+ *
+ */
+static void free_node(LockFreeQueue *queue, LockFreeNode *node) {
+    // Variable declaration
+    LockFreeNode *top;
+
+    if (node_cache_put(node, queue->node_size)) {
+        return;
+    }
+    if (atomic_fetch_add_explicit(&queue->free_count, 1, memory_order_relaxed) >= queue->max_retained) {
+        atomic_fetch_sub_explicit(&queue->free_count, 1, memory_order_relaxed);
+        free(node);
+        return;
+    }
+
+    top = atomic_load_explicit(&queue->free_nodes, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&node->next, top, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak(&queue->free_nodes, &top, node));
+}
+
+/**
+ * @brief Frees every node on the queue's free list.
+ *
+ * @note Used by lock_free_queue_create on failure and by lock_free_destroy.
+ *
+ */
+static void free_node_list(LockFreeQueue *queue) {
+    // Variable declaration
+    LockFreeNode *current_node;
+    LockFreeNode *next_node;
+
+    current_node = atomic_load_explicit(&queue->free_nodes, memory_order_relaxed);
+    while (current_node != NULL) {
+        next_node = atomic_load_explicit(&current_node->next, memory_order_relaxed);
+        free(current_node);
+        current_node = next_node;
+    }
+    atomic_store_explicit(&queue->free_nodes, NULL, memory_order_relaxed);
+    atomic_store_explicit(&queue->free_count, 0, memory_order_relaxed);
+}
+
+/* Used sources
+    1. Michael-Scott queue: https://www.cs.rochester.edu/~scott/papers/1996_PODC_queues.pdf
+    2. Hazard pointers: https://www.cs.otago.ac.nz/cosc440/readings/hazard-pointers.pdf
+    3. Atomics: https://en.cppreference.com/w/c/atomic
+*/
@@ -0,0 +1,294 @@
+// Includes
+#include <stdbool.h>
+#include <stdlib.h>
+#include <threads.h>
+#include "node_pool.h"
+
+// Struct defs
+typedef struct {
+    size_t node_size;
+    PoolNode *free_nodes;
+    size_t free_count;
+} NodeCacheClass;
+
+typedef struct {
+    NodeCacheClass classes[NODE_CACHE_CLASSES];
+    bool registered;
+} NodeCache;
+
+
+// Function declaration
+static NodeCacheClass* find_cache_class(size_t, bool);
+static void register_thread_cache(void);
+static void create_cache_key(void);
+static void free_thread_cache(void*);
+static void free_node_list(PoolNode*);
+
+
+// Global variables declarations
+static _Thread_local NodeCache thread_cache;
+static tss_t cache_key;
+static once_flag cache_key_once = ONCE_FLAG_INIT;
+
+/*Interface methods*/
+
+/**
+ * @brief Initializes a pool of fixed size nodes and prewarms it.
+ *
+ * Allocates min(prewarm, max_retained) nodes up front so the first operations on a fresh queue already
+ * find their nodes in the pool.
+ *
+ * @param pool The pool to initialize.
+ * @param node_size The size of every node handed out by the pool.
+ * @param prewarm The amount of nodes to allocate up front.
+ * @param max_retained The maximal amount of free nodes the pool keeps.
+ *
+ * @return True on success, false if prewarming failed to allocate memory.
+ *
+ */
+bool node_pool_init(NodePool *pool, size_t node_size, size_t prewarm, size_t max_retained) {
+    // Variable declaration
+    size_t i;
+    PoolNode *new_node;
+
+    pool->free_nodes = NULL;
+    pool->free_count = 0;
+    pool->max_retained = max_retained;
+    pool->node_size = node_size < sizeof(PoolNode) ? sizeof(PoolNode) : node_size;
+
+    if (prewarm > max_retained) {
+        prewarm = max_retained;
+    }
+    for (i = 0; i < prewarm; i++) {
+        new_node = malloc(pool->node_size);
+        if (new_node == NULL) {
+            node_pool_destroy(pool);
+            return false;
+        }
+        new_node->next = pool->free_nodes;
+        pool->free_nodes = new_node;
+        pool->free_count++;
+    }
+    return true;
+}
+
+/**
+ * @brief Takes a node from the pool, or from the heap if the pool is empty.
+ *
+ * @param pool The pool to allocate from, its lock must be held by the caller.
+ *
+ * @return A node of pool->node_size bytes, or NULL if memory allocation failed.
+ *
+ */
+void* node_pool_alloc(NodePool *pool) {
+    // Variable declaration
+    PoolNode *node_to_return;
+
+    if (pool->free_nodes == NULL) {
+        return malloc(pool->node_size);
+    }
+
+    node_to_return = pool->free_nodes;
+    pool->free_nodes = node_to_return->next;
+    pool->free_count--;
+    return node_to_return;
+}
+
+/**
+ * @brief Returns a node to the calling thread's cache, the pool, or the heap, whichever has room first.
+ *
+ * The thread cache is tried first since it needs no synchronization and is the first place
+ * node_cache_take looks at, so a thread that both enqueues and dequeues recycles its own nodes.
+ *
+ * @param pool The pool the node was allocated from, its lock must be held by the caller.
+ * @param node The node to release.
+ *
+ */
+void node_pool_release(NodePool *pool, void *node) {
+    // Variable declaration
+    PoolNode *released_node = node;
+
+    if (node_cache_put(released_node, pool->node_size)) {
+        return;
+    }
+
+    if (pool->free_count < pool->max_retained) {
+        released_node->next = pool->free_nodes;
+        pool->free_nodes = released_node;
+        pool->free_count++;
+        return;
+    }
+    free(released_node);
+}
+
+/**
+ * @brief Takes a node of node_size bytes from the calling thread's cache without any locking.
+ *
+ * @param node_size The size of the requested node.
+ *
+ * @return A cached node, or NULL if the cache holds no node of that size.
+ *
+ */
+void* node_cache_take(size_t node_size) {
+    // Variable declaration
+    NodeCacheClass *cache_class;
+    PoolNode *node_to_return;
+
+    if (node_size < sizeof(PoolNode)) {
+        node_size = sizeof(PoolNode);
+    }
+    cache_class = find_cache_class(node_size, false);
+    if (cache_class == NULL || cache_class->free_nodes == NULL) {
+        return NULL;
+    }
+
+    node_to_return = cache_class->free_nodes;
+    cache_class->free_nodes = node_to_return->next;
+    cache_class->free_count--;
+    return node_to_return;
+}
+
+/**
+ * @brief Puts a node of node_size bytes into the calling thread's cache without any locking.
+ *
+ * @param node The node to cache.
+ * @param node_size The size of the node.
+ *
+ * @return True if the node was cached, false if the cache is full and the caller still owns the node.
+ *
+ */
+bool node_cache_put(void *node, size_t node_size) {
+    // Variable declaration
+    NodeCacheClass *cache_class;
+    PoolNode *cached_node = node;
+
+    if (node_size < sizeof(PoolNode)) {
+        node_size = sizeof(PoolNode);
+    }
+    cache_class = find_cache_class(node_size, true);
+    if (cache_class == NULL || cache_class->free_count >= NODE_CACHE_CAPACITY) {
+        return false;
+    }
+
+    register_thread_cache();
+    cached_node->next = cache_class->free_nodes;
+    cache_class->free_nodes = cached_node;
+    cache_class->free_count++;
+    return true;
+}
+
+/**
+ * @brief Frees every node retained by the pool.
+ *
+ * Nodes held by thread caches are plain heap blocks and are freed when their thread exits.
+ *
+ * @param pool The pool to destroy.
+ *
+ */
+void node_pool_destroy(NodePool *pool) {
+    free_node_list(pool->free_nodes);
+    pool->free_nodes = NULL;
+    pool->free_count = 0;
+}
+
+/*Private methods*/
+
+/**
+ * @brief Finds the calling thread's cache class of the given node size.
+ *
+ * @param node_size The node size of the requested class.
+ * @param create Whether to claim an unused class if none matches.
+ *
+ * @return The matching class, or NULL if none exists (and none could be claimed).
+ *
+ * @note Used by node_cache_take and node_cache_put.
+ *
+ */
+static NodeCacheClass* find_cache_class(size_t node_size, bool create) {
+    // Variable declaration
+    int i;
+    NodeCacheClass *current_class;
+
+    for (i = 0; i < NODE_CACHE_CLASSES; i++) {
+        current_class = &thread_cache.classes[i];
+        if (current_class->node_size == node_size) {
+            return current_class;
+        }
+        if (current_class->node_size == 0) {
+            if (!create) {
+                return NULL;
+            }
+            current_class->node_size = node_size;
+            return current_class;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Registers the calling thread's cache with a TSS destructor so it is freed when the thread exits.
+ *
+ * @note Used by node_cache_put.
+ *
+ */
+static void register_thread_cache(void) {
+    if (thread_cache.registered) {
+        return;
+    }
+    call_once(&cache_key_once, create_cache_key);
+    thread_cache.registered = tss_set(cache_key, &thread_cache) == thrd_success;
+}
+
+/**
+ * @brief Creates the TSS key whose destructor frees thread caches.
+ *
+ * @note Used by register_thread_cache through call_once.
+ *
+ */
+static void create_cache_key(void) {
+    tss_create(&cache_key, free_thread_cache);
+}
+
+/**
+ * @brief Frees every node held by an exiting thread's cache.
+ *
+ * @param cache A pointer to the exiting thread's NodeCache.
+ *
+ * @note Used as the TSS destructor of cache_key.
+ *
+ */
+static void free_thread_cache(void *cache) {
+    // Variable declaration
+    int i;
+    NodeCache *exiting_cache = cache;
+
+    for (i = 0; i < NODE_CACHE_CLASSES; i++) {
+        free_node_list(exiting_cache->classes[i].free_nodes);
+        exiting_cache->classes[i].free_nodes = NULL;
+        exiting_cache->classes[i].free_count = 0;
+    }
+    exiting_cache->registered = false;
+}
+
+/**
+ * @brief Frees every node of a singly linked list of pool nodes.
+ *
+ * @param current_node The head of the list.
+ *
+ * @note Used by node_pool_destroy and free_thread_cache.
+ *
+ */
+static void free_node_list(PoolNode *current_node) {
+    // Variable declaration
+    PoolNode *next_node;
+
+    while (current_node != NULL) {
+        next_node = current_node->next;
+        free(current_node);
+        current_node = next_node;
+    }
+}
+
+/* Used sources
+    1. Thread storage: https://en.cppreference.com/w/c/thread#Thread-local_storage
+*/
@@ -0,0 +1,69 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+// Includes
+#include <stdbool.h>
+#include <stddef.h>
+
+// Constants
+#define NODE_CACHE_CAPACITY 64
+#define NODE_CACHE_CLASSES 4
+
+// Struct defs
+typedef struct PoolNode {
+    struct PoolNode *next;
+} PoolNode;
+
+typedef struct {
+    PoolNode *free_nodes;
+    size_t free_count;
+    size_t max_retained;
+    size_t node_size;
+} NodePool;
+
+/**
+ * @brief Initializes a pool of fixed size nodes and prewarms it.
+ *
+ * The pool is not synchronized, callers must hold the lock protecting it.
+ *
+ * @param pool The pool to initialize.
+ * @param node_size The size of every node handed out by the pool, at least sizeof(PoolNode).
+ * @param prewarm The amount of nodes to allocate up front, capped by max_retained.
+ * @param max_retained The maximal amount of free nodes the pool keeps before returning them to the heap.
+ *
+ * @return True on success, false if prewarming failed to allocate memory.
+ */
+bool node_pool_init(NodePool *pool, size_t node_size, size_t prewarm, size_t max_retained);
+
+/**
+ * @brief Takes a node from the pool, or from the heap if the pool is empty.
+ *
+ * @return A node of pool->node_size bytes, or NULL if memory allocation failed.
+ */
+void* node_pool_alloc(NodePool *pool);
+
+/**
+ * @brief Returns a node to the calling thread's cache, the pool, or the heap, whichever has room first.
+ */
+void node_pool_release(NodePool *pool, void *node);
+
+/**
+ * @brief Takes a node of node_size bytes from the calling thread's cache without any locking.
+ *
+ * @return A cached node, or NULL if the cache holds no node of that size.
+ */
+void* node_cache_take(size_t node_size);
+
+/**
+ * @brief Puts a node of node_size bytes into the calling thread's cache without any locking.
+ *
+ * @return True if the node was cached, false if the cache is full and the caller still owns the node.
+ */
+bool node_cache_put(void *node, size_t node_size);
+
+/**
+ * @brief Frees every node retained by the pool.
+ */
+void node_pool_destroy(NodePool *pool);
+
+#endif
@@ -0,0 +1,118 @@
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <threads.h>
+#include "parker.h"
+#include "queue_trace.h"
+
+/*Interface methods*/
+
+/**
+ * @brief Initializes the waiting counter, lock and condition variable of a parker.
+ *
+ * @param parker The parker to initialize.
+ *
+ * @return True on success, false if its lock or condition variable could not be initialized.
+ *
+ */
+bool parker_init(Parker *parker) {
+    atomic_init(&parker->waiting, 0);
+    if (mtx_init(&parker->lock, mtx_plain) != thrd_success) {
+        return false;
+    }
+    if (cnd_init(&parker->condition) != thrd_success) {
+        mtx_destroy(&parker->lock);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Destroys the lock and condition variable of a parker.
+ *
+ * @param parker The parker to destroy.
+ *
+ */
+void parker_destroy(Parker *parker) {
+    cnd_destroy(&parker->condition);
+    mtx_destroy(&parker->lock);
+}
+
+/**
+ * @brief Calls attempt until it succeeds, parking the calling thread between failed attempts.
+ *
+ * The fast path is a single attempt without touching the parker. Otherwise the thread takes the parker's
+ * lock, registers itself in the waiting counter and attempts once more before sleeping. Since parker_wake
+ * reads the counter after the waker published its state and then takes the same lock to signal, either
+ * the last attempt sees that state or the signal is delivered after the thread went to sleep. The fences
+ * on both sides keep that argument valid when the state itself is published with release stores only.
+ *
+ * @param parker The parker to wait on.
+ * @param attempt A non blocking operation returning true once it succeeded.
+ * @param context The argument passed to attempt.
+ *
+ */
+void parker_wait(Parker *parker, bool (*attempt)(void*), void *context) {
+    // Variable declaration
+    uint64_t trace_start;
+
+    if (attempt(context)) {
+        return;
+    }
+
+    trace_start = queue_trace_begin();
+    mtx_lock(&parker->lock);
+    atomic_fetch_add(&parker->waiting, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!attempt(context)) {
+        cnd_wait(&parker->condition, &parker->lock);
+    }
+    atomic_fetch_sub(&parker->waiting, 1);
+    mtx_unlock(&parker->lock);
+    queue_trace_end(QUEUE_TRACE_PARK, parker, trace_start);
+}
+
+/**
+ * @brief Wakes up one parked thread, if any.
+ *
+ * The lock is only taken when a thread is registered as waiting, so wakers pay a single atomic load
+ * while nobody is parked.
+ *
+ * @param parker The parker to wake a thread from.
+ *
+ */
+void parker_wake(Parker *parker) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&parker->waiting) == 0) {
+        return;
+    }
+
+    mtx_lock(&parker->lock);
+    cnd_signal(&parker->condition);
+    mtx_unlock(&parker->lock);
+    queue_trace_instant(QUEUE_TRACE_WAKE, parker, 1);
+}
+
+/**
+ * @brief Wakes up every parked thread, for state changes all of them have to observe such as shutdown.
+ *
+ * @param parker The parker to wake the threads from.
+ *
+ */
+void parker_wake_all(Parker *parker) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&parker->waiting) == 0) {
+        return;
+    }
+
+    mtx_lock(&parker->lock);
+    cnd_broadcast(&parker->condition);
+    mtx_unlock(&parker->lock);
+    queue_trace_instant(QUEUE_TRACE_WAKE, parker, 1);
+}
+
+/* Used sources
+    1. Atomics: https://en.cppreference.com/w/c/atomic
+    2. Concurrency methods: https://en.cppreference.com/w/c/thread
+*/
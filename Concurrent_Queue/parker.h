@@ -0,0 +1,50 @@
+#ifndef PARKER_H
+#define PARKER_H
+
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <threads.h>
+
+// Struct defs
+typedef struct {
+    atomic_int waiting;
+    mtx_t lock;
+    cnd_t condition;
+} Parker;
+
+/**
+ * @brief Initializes a parker.
+ *
+ * @return True on success, false if its lock or condition variable could not be initialized.
+ */
+bool parker_init(Parker *parker);
+
+/**
+ * @brief Destroys a parker. No thread may be parked on it.
+ */
+void parker_destroy(Parker *parker);
+
+/**
+ * @brief Calls attempt until it succeeds, parking the calling thread between failed attempts.
+ *
+ * The thread only sleeps after a final attempt made while registered as waiting has failed, so a
+ * parker_wake issued after the state attempt looks at was published can never be missed.
+ *
+ * @param parker The parker to wait on.
+ * @param attempt A non blocking operation returning true once it succeeded.
+ * @param context The argument passed to attempt.
+ */
+void parker_wait(Parker *parker, bool (*attempt)(void*), void *context);
+
+/**
+ * @brief Wakes up one parked thread, if any. Must be called after the state it waits for was published.
+ */
+void parker_wake(Parker *parker);
+
+/**
+ * @brief Wakes up every parked thread. Must be called after the state they wait for was published.
+ */
+void parker_wake_all(Parker *parker);
+
+#endif
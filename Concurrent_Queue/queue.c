@@ -1,24 +1,52 @@
 // Includes
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <threads.h>
+#include <time.h>
+#include "futex.h"
+#include "node_pool.h"
+#include "queue_internal.h"
+#include "queue_notifier.h"
+#include "queue_stats.h"
+#include "queue_trace.h"
+
+// Constants
+#define THREAD_WAITING 0
+#define THREAD_PARKED 1
+#define THREAD_SERVED 2
 
 // Struct defs
 typedef struct QueueElem{
-    void *item;
+    uint64_t enqueue_time;
     struct QueueElem *next;
+    unsigned char value[];
 } QueueElem;
 
 typedef struct {
     QueueElem *head;
     QueueElem *tail;
+    size_t served_stamp;
+} Lane;
+
+typedef struct {
+    Lane lanes[QUEUE_MAX_PRIORITY_LANES];
+    unsigned int lane_mask;
+    unsigned int lane_amount;
+    unsigned int aging;
     int queue_size;
-    size_t visited_items;
+    size_t dequeue_count;
+    atomic_size_t visited_items;
 } Queue;
 
 typedef struct ThreadNode {
-    cnd_t *condition;
+    mtx_t handoff_lock;
+    cnd_t condition;
+    atomic_uint state;
+    void *destination;
+    bool served;
     struct ThreadNode *next;
 } ThreadNode;
 
@@ -28,355 +56,1424 @@ typedef struct {
     int queue_size;
 }ThreadQueue;
 
+typedef struct {
+    ConcurrentQueue base;
+    Queue item_queue;
+    ThreadQueue thread_queue;
+    mtx_t queue_lock;
+    cnd_t batch_condition;
+    int batch_waiters;
+    NodePool item_pool;
+    QueueWaitMode wait_mode;
+    unsigned int spin_budget;
+} MutexQueue;
+
 
 // Function declaration
-void initQueue(void);
-void enqueue(void*);
-void* dequeue(void);
-bool tryDequeue(void**);
-size_t visited(void);
-void destroyQueue(void);
-static void init_item_queue();
-static void init_thread_queue();
-static QueueElem* init_item(void*);
-static void add_element_to_item_queue(QueueElem*);
-static void check_for_waiting_threads();
-static void deal_with_empty_queue();
-static void* item_dequeue_impl();
-static void thread_enqueue(cnd_t *);
-static ThreadNode* init_thread_node(cnd_t*);
-static void add_element_to_thread_queue(ThreadNode*); 
-static cnd_t* thread_dequeue();
-static QueueElem* dequeue_first_non_acquired_element(int);
+static ConcurrentQueue* mutex_queue_create(const QueueConfig*);
+static bool mutex_enqueue(ConcurrentQueue*, const void*);
+static bool mutex_enqueue_priority(ConcurrentQueue*, const void*, unsigned int);
+static void mutex_dequeue(ConcurrentQueue*, void*);
+static bool mutex_try_dequeue(ConcurrentQueue*, void*);
+static size_t mutex_enqueue_batch(ConcurrentQueue*, const void*, size_t);
+static size_t mutex_dequeue_batch(ConcurrentQueue*, void*, size_t, size_t, const struct timespec*);
+static size_t mutex_visited(ConcurrentQueue*);
+static void mutex_destroy(ConcurrentQueue*);
+static size_t enqueue_batch_fallback(ConcurrentQueue*, const void*, size_t);
+static size_t dequeue_batch_fallback(ConcurrentQueue*, void*, size_t, size_t, const struct timespec*);
+static bool deadline_passed(const struct timespec*);
+static void count_visited_item(Queue*);
+static void init_item_queue(Queue*, const QueueConfig*);
+static void init_thread_queue(ThreadQueue*);
+static QueueElem* init_item(MutexQueue*, const void*);
+static void add_element_to_item_queue(MutexQueue*, QueueElem*, unsigned int);
+static void add_chain_to_item_queue(MutexQueue*, QueueElem*, QueueElem*, int, unsigned int);
+static unsigned int select_lane(Queue*);
+static ThreadNode* hand_item_to_waiting_thread(MutexQueue*, const void*);
+static void wake_served_thread(MutexQueue*, ThreadNode*);
+static void wake_batch_waiters(MutexQueue*);
+static void deal_with_empty_queue(MutexQueue*, void*);
+static void wait_on_condition(ThreadNode*);
+static void spin_then_park(MutexQueue*, ThreadNode*);
+static void item_dequeue_impl(MutexQueue*, void*);
+static void thread_enqueue(MutexQueue*, ThreadNode*);
+static void init_thread_node(MutexQueue*, ThreadNode*);
+static void add_element_to_thread_queue(MutexQueue*, ThreadNode*); 
+static ThreadNode* thread_dequeue(MutexQueue*);
 
 
 // Global variables declarations
-static Queue *item_queue;
-static ThreadQueue *thread_queue;
-static mtx_t queue_lock;
+static const QueueOps mutex_ops = {
+    .enqueue = mutex_enqueue,
+    .enqueue_priority = mutex_enqueue_priority,
+    .dequeue = mutex_dequeue,
+    .try_dequeue = mutex_try_dequeue,
+    .enqueue_batch = mutex_enqueue_batch,
+    .dequeue_batch = mutex_dequeue_batch,
+    .visited = mutex_visited,
+    .destroy = mutex_destroy,
+};
+static ConcurrentQueue *default_queue;
 
 /*Interface methods*/
 
 /**
- * @brief Initializes the item queue, thread queue and lock.
+ * @brief Fills a QueueConfig with the default settings used by queueCreate.
+ *
+ * @param config The configuration to fill.
+ *
  */
-void initQueue(void) {
+void queueDefaultConfig(QueueConfig *config) {
+    config->mode = QUEUE_MODE_MUTEX;
+    config->element_size = 0;
+    config->pool_prewarm = QUEUE_DEFAULT_POOL_PREWARM;
+    config->pool_max_retained = QUEUE_DEFAULT_POOL_MAX_RETAINED;
+    config->ring_capacity = QUEUE_DEFAULT_RING_CAPACITY;
+    config->segment_capacity = QUEUE_DEFAULT_SEGMENT_CAPACITY;
+    config->full_policy = QUEUE_FULL_BLOCK;
+    config->wait_mode = QUEUE_WAIT_CONDVAR;
+    config->spin_budget = QUEUE_DEFAULT_SPIN_BUDGET;
+    config->priority_lanes = 1;
+    config->priority_aging = QUEUE_DEFAULT_PRIORITY_AGING;
+    config->enable_stats = false;
+    config->enable_fd = false;
+}
 
-    init_item_queue();
+/**
+ * @brief Allocates a new queue instance with the default configuration.
+ *
+ * @return A pointer to the new queue instance, or NULL if memory allocation failed.
+ *
+ */
+ConcurrentQueue* queueCreate(void) {
+    // Variable declaration
+    QueueConfig config;
 
-    init_thread_queue();
+    queueDefaultConfig(&config);
+    return queueCreateWithConfig(&config);
+}
 
-    mtx_init(&queue_lock, mtx_plain);
+/**
+ * @brief Allocates a new queue instance in the mode selected by the configuration.
+ *
+ * The statistics block is attached after the mode created the queue, so modes only need to pass
+ * queue->base.stats to the queue_stats methods, which ignore a NULL block. The eventfd notifier is
+ * attached the same way and signaled by the enqueue methods of this layer, so modes are not aware of it.
+ *
+ * @param config The configuration of the new queue instance.
+ *
+ * @return A pointer to the new queue instance, or NULL if memory allocation failed or the mode is unknown.
+ *
+ */
+ConcurrentQueue* queueCreateWithConfig(const QueueConfig *config) {
+    // Variable declaration
+    ConcurrentQueue *queue;
+    QueueConfig normalized_config = *config;
+
+    if (normalized_config.element_size == 0) {
+        normalized_config.element_size = sizeof(void*);
+    }
+    switch (normalized_config.mode) {
+        case QUEUE_MODE_MUTEX:
+            queue = mutex_queue_create(&normalized_config);
+            break;
+        case QUEUE_MODE_LOCK_FREE:
+            queue = lock_free_queue_create(&normalized_config);
+            break;
+        case QUEUE_MODE_RING:
+            queue = ring_queue_create(&normalized_config);
+            break;
+        case QUEUE_MODE_TWO_LOCK:
+            queue = two_lock_queue_create(&normalized_config);
+            break;
+        case QUEUE_MODE_SEGMENTED:
+            queue = segmented_queue_create(&normalized_config);
+            break;
+        case QUEUE_MODE_SPSC:
+            queue = spsc_queue_create(&normalized_config);
+            break;
+        case QUEUE_MODE_FLAT_COMBINING:
+            queue = flat_combining_queue_create(&normalized_config);
+            break;
+        default:
+            return NULL;
+    }
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    queue->element_size = normalized_config.element_size;
+    queue->stats = NULL;
+    queue->notifier = NULL;
+    if (config->enable_stats) {
+        queue->stats = queue_stats_create();
+        if (queue->stats == NULL) {
+            queue->ops->destroy(queue);
+            return NULL;
+        }
+    }
+    if (config->enable_fd) {
+        queue->notifier = queue_notifier_create();
+        if (queue->notifier == NULL) {
+            queueDestroy(queue);
+            return NULL;
+        }
+    }
+    return queue;
 }
 
 /**
- * @brief Enqueues an item into the item queue and wakes up a waiting thread if one exists.
+ * @brief Enqueues an item into a queue instance of void* items.
  *
- * The method starts by an attempt at locking, then uses two helper methods to add an element into 
- * the queue and check (and wake up if exists) for waiting threads.
+ * @param queue The queue instance to enqueue into.
+ * @param element_to_enqueue  A pointer to the element the user wants to enqueue.
+ *
+ * @return True if the element was enqueued, otherwise false.
+ *
+ */
+bool queueEnqueue(ConcurrentQueue *queue, void *element_to_enqueue) {
+    return queueEnqueueValue(queue, &element_to_enqueue);
+}
+
+/**
+ * @brief Enqueues an item into a priority lane of a queue instance of void* items.
  *
+ * @param queue The queue instance to enqueue into.
  * @param element_to_enqueue  A pointer to the element the user wants to enqueue.
+ * @param priority The lane of the element, higher is more urgent.
+ *
+ * @return True if the element was enqueued, otherwise false.
  *
  */
-void enqueue(void *element_to_enqueue) {
+bool queueEnqueuePriority(ConcurrentQueue *queue, void *element_to_enqueue, unsigned int priority) {
+    return queueEnqueueValuePriority(queue, &element_to_enqueue, priority);
+}
+
+/**
+ * @brief Dequeues an item from a queue instance of void* items, blocking while it is empty.
+ *
+ * @param queue The queue instance to dequeue from.
+ *
+ * @return The dequeued item.
+ *
+ */
+void* queueDequeue(ConcurrentQueue *queue) {
     // Variable declaration
-    QueueElem *new_element;
+    void *item_to_return;
+
+    queueDequeueValue(queue, &item_to_return);
+    return item_to_return;
+}
+
+/**
+ * @brief Tries to dequeue an item from a queue instance of void* items without blocking.
+ *
+ * @param queue The queue instance to dequeue from.
+ * @param item_of_element_to_dequeue A pointer to the location in memory in which to save the dequeued item, if able to.
+ *
+ * @return True if an element was successfully dequeued, other wise false.
+ *
+ */
+bool queueTryDequeue(ConcurrentQueue *queue, void **item_of_element_to_dequeue) {
+    return queueTryDequeueValue(queue, item_of_element_to_dequeue);
+}
+
+/**
+ * @brief Enqueues several items into a queue instance of void* items. An array of items is an array of
+ * pointer sized values, so it is handed to the value batch as is.
+ *
+ * @param queue The queue instance to enqueue into.
+ * @param items The items to enqueue, in FIFO order.
+ * @param amount The amount of items.
+ *
+ * @return The amount of items enqueued, always a prefix of items.
+ *
+ */
+size_t queueEnqueueBatch(ConcurrentQueue *queue, void* const *items, size_t amount) {
+    return queueEnqueueValueBatch(queue, items, amount);
+}
 
-    new_element = init_item(element_to_enqueue);
-    mtx_lock(&queue_lock);
+/**
+ * @brief Dequeues up to max_items items from a queue instance of void* items once min_items are available
+ * or the deadline passed.
+ *
+ * @param queue The queue instance to dequeue from.
+ * @param items The array in which to save the dequeued items.
+ * @param max_items The maximal amount of items to dequeue.
+ * @param min_items The amount of items to wait for.
+ * @param deadline An absolute TIME_UTC deadline, or NULL to wait for min_items indefinitely.
+ *
+ * @return The amount of items dequeued.
+ *
+ */
+size_t queueDequeueBatch(ConcurrentQueue *queue, void **items, size_t max_items, size_t min_items,
+                         const struct timespec *deadline) {
+    return queueDequeueValueBatch(queue, items, max_items, min_items, deadline);
+}
 
-    add_element_to_item_queue(new_element);
-    check_for_waiting_threads();
+/**
+ * @brief Returns the size of the values held by a queue instance.
+ *
+ * @param queue The queue instance to query.
+ *
+ */
+size_t queueElementSize(ConcurrentQueue *queue) {
+    return queue->element_size;
+}
 
-    mtx_unlock(&queue_lock);
+/**
+ * @brief Copies a value into a queue instance through its mode's operations.
+ *
+ * @param queue The queue instance to enqueue into.
+ * @param value A pointer to the value to copy.
+ *
+ * @return True if the value was enqueued, otherwise false.
+ *
+ */
+bool queueEnqueueValue(ConcurrentQueue *queue, const void *value) {
+    if (!queue->ops->enqueue(queue, value)) {
+        return false;
+    }
+    queue_stats_add(queue->stats, STAT_ENQUEUED, 1);
+    queue_trace_instant(QUEUE_TRACE_ENQUEUE, queue, 1);
+    queue_notifier_signal(queue->notifier);
+    return true;
 }
 
 /**
- * @brief Tries to dequeue an element from the item queue. If queue is empty, sleeps until an element
- * is added to the queue and its turn arrives.
+ * @brief Copies a value into a priority lane of a queue instance, or enqueues it plainly if the mode has
+ * no priority lanes.
+ *
+ * @param queue The queue instance to enqueue into.
+ * @param value A pointer to the value to copy.
+ * @param priority The lane of the value, higher is more urgent.
+ *
+ * @return True if the value was enqueued, otherwise false.
+ *
+ */
+bool queueEnqueueValuePriority(ConcurrentQueue *queue, const void *value, unsigned int priority) {
+    if (queue->ops->enqueue_priority == NULL) {
+        return queueEnqueueValue(queue, value);
+    }
+    if (!queue->ops->enqueue_priority(queue, value, priority)) {
+        return false;
+    }
+    queue_stats_add(queue->stats, STAT_ENQUEUED, 1);
+    queue_trace_instant(QUEUE_TRACE_ENQUEUE, queue, 1);
+    queue_notifier_signal(queue->notifier);
+    return true;
+}
+
+/**
+ * @brief Copies the head value out of a queue instance through its mode's operations, blocking while it is empty.
+ *
+ * @param queue The queue instance to dequeue from.
+ * @param value A pointer to the location in which to save the value.
+ *
+ */
+void queueDequeueValue(ConcurrentQueue *queue, void *value) {
+    queue->ops->dequeue(queue, value);
+    queue_stats_add(queue->stats, STAT_DEQUEUED, 1);
+    queue_trace_instant(QUEUE_TRACE_DEQUEUE, queue, 1);
+}
+
+/**
+ * @brief Tries to copy the head value out of a queue instance through its mode's operations without blocking.
+ *
+ * @param queue The queue instance to dequeue from.
+ * @param value A pointer to the location in which to save the value, if able to.
+ *
+ * @return True if a value was dequeued, otherwise false.
+ *
+ */
+bool queueTryDequeueValue(ConcurrentQueue *queue, void *value) {
+    if (!queue->ops->try_dequeue(queue, value)) {
+        queue_stats_add(queue->stats, STAT_TRY_MISSES, 1);
+        return false;
+    }
+    queue_stats_add(queue->stats, STAT_TRY_HITS, 1);
+    queue_stats_add(queue->stats, STAT_DEQUEUED, 1);
+    queue_trace_instant(QUEUE_TRACE_DEQUEUE, queue, 1);
+    return true;
+}
+
+/**
+ * @brief Copies several values into a queue instance, through its mode's batch operation if it has one.
  *
- * The method calls a helper method to see if the queue is currently empty and deals with it by enqueueing 
- * itself into the thread queue with a unique CV. This insures that it will be woken up when the item queue
- * is not empty and it is the first in line to dequeue it.
+ * @param queue The queue instance to enqueue into.
+ * @param values The values to enqueue, in FIFO order.
+ * @param amount The amount of values.
+ *
+ * @return The amount of values enqueued, always a prefix of values.
+ *
+ */
+size_t queueEnqueueValueBatch(ConcurrentQueue *queue, const void *values, size_t amount) {
+    // Variable declaration
+    size_t enqueued_amount;
+
+    if (queue->ops->enqueue_batch == NULL) {
+        enqueued_amount = enqueue_batch_fallback(queue, values, amount);
+    }
+    else {
+        enqueued_amount = queue->ops->enqueue_batch(queue, values, amount);
+    }
+    queue_stats_add(queue->stats, STAT_ENQUEUED, enqueued_amount);
+    if (enqueued_amount > 0) {
+        queue_trace_instant(QUEUE_TRACE_ENQUEUE, queue, enqueued_amount);
+        queue_notifier_signal(queue->notifier);
+    }
+    return enqueued_amount;
+}
+
+/**
+ * @brief Copies up to max_values values out of a queue instance once min_values are available or the deadline
+ * passed, through its mode's batch operation if it has one.
+ *
+ * @param queue The queue instance to dequeue from.
+ * @param values The array in which to save the values.
+ * @param max_values The maximal amount of values to dequeue.
+ * @param min_values The amount of values to wait for.
+ * @param deadline An absolute TIME_UTC deadline, or NULL to wait for min_values indefinitely.
+ *
+ * @return The amount of values dequeued.
+ *
+ */
+size_t queueDequeueValueBatch(ConcurrentQueue *queue, void *values, size_t max_values, size_t min_values,
+                              const struct timespec *deadline) {
+    // Variable declaration
+    size_t dequeued_amount;
+
+    if (min_values > max_values) {
+        min_values = max_values;
+    }
+    if (queue->ops->dequeue_batch == NULL) {
+        dequeued_amount = dequeue_batch_fallback(queue, values, max_values, min_values, deadline);
+    }
+    else {
+        dequeued_amount = queue->ops->dequeue_batch(queue, values, max_values, min_values, deadline);
+    }
+    queue_stats_add(queue->stats, STAT_DEQUEUED, dequeued_amount);
+    if (dequeued_amount > 0) {
+        queue_trace_instant(QUEUE_TRACE_DEQUEUE, queue, dequeued_amount);
+    }
+    return dequeued_amount;
+}
+
+/**
+ * @brief Returns the amount of elements that where enqueued and then dequeued from a queue instance.
+ *
+ * @param queue The queue instance to query.
+ *
+ */
+size_t queueVisited(ConcurrentQueue *queue) {
+    return queue->ops->visited(queue);
+}
+
+/**
+ * @brief Takes a snapshot of a queue instance's statistics without stopping other threads.
+ *
+ * @param queue The queue instance to query.
+ * @param snapshot A pointer to the location in which to save the statistics.
+ *
+ * @return True on success, false if the queue instance was created without enable_stats.
+ *
+ */
+bool queueStats(ConcurrentQueue *queue, QueueStatsSnapshot *snapshot) {
+    if (queue->stats == NULL) {
+        return false;
+    }
+    queue_stats_snapshot(queue->stats, snapshot);
+    return true;
+}
+
+/**
+ * @brief Returns the eventfd of a queue instance.
+ *
+ * @param queue The queue instance to query.
+ *
+ * @return The file descriptor, or -1 if the queue instance was created without enable_fd.
+ *
+ */
+int queueGetFd(ConcurrentQueue *queue) {
+    if (queue->notifier == NULL) {
+        return -1;
+    }
+    return queue->notifier->event_fd;
+}
+
+/**
+ * @brief Acknowledges the eventfd of a queue instance before its consumer drains it.
+ *
+ * @param queue The queue instance whose eventfd to acknowledge.
+ *
+ * @return True if the eventfd was readable, false otherwise or if the queue instance has no eventfd.
+ *
+ */
+bool queueAckFd(ConcurrentQueue *queue) {
+    if (queue->notifier == NULL) {
+        return false;
+    }
+    return queue_notifier_ack(queue->notifier);
+}
+
+/**
+ * @brief Destroys a queue instance through its mode's operations.
+ *
+ * @param queue The queue instance to destroy.
+ *
+ */
+void queueDestroy(ConcurrentQueue *queue) {
+    // Variable declaration
+    QueueStats *stats = queue->stats;
+    QueueNotifier *notifier = queue->notifier;
+
+    queue->ops->destroy(queue);
+    queue_stats_destroy(stats);
+    queue_notifier_destroy(notifier);
+}
+
+/*Default instance interface*/
+
+/**
+ * @brief Initializes the default queue instance used by the global interface methods.
+ */
+void initQueue(void) {
+    default_queue = queueCreate();
+}
+
+/**
+ * @brief Enqueues an item into the default queue instance.
+ *
+ * @param element_to_enqueue  A pointer to the element the user wants to enqueue.
+ *
+ */
+void enqueue(void *element_to_enqueue) {
+    queueEnqueue(default_queue, element_to_enqueue);
+}
+
+/**
+ * @brief Dequeues an item from the default queue instance, blocking while it is empty.
  *
  * @return The item field of the dequeued queue element.
  *
  */
 void* dequeue(void) {
+    return queueDequeue(default_queue);
+}
+
+/**
+ * @brief Tries to dequeue an item from the default queue instance without blocking.
+ *
+ * @param item_of_element_to_dequeue A pointer to the location in memory in which to save the dequeued item, if able to.
+ *
+ * @return True if an element was successfully dequeued, other wise false.
+ *
+ */
+bool tryDequeue(void **item_of_element_to_dequeue) {
+    return queueTryDequeue(default_queue, item_of_element_to_dequeue);
+}
+
+/**
+ * @brief Returns the amount of elements that where enqueued and then dequeued from the default queue instance.
+ */
+size_t visited(void) {
+    return queueVisited(default_queue);
+}
+
+/**
+ * @brief Destroys the default queue instance.
+ */
+void destroyQueue(void) {
+    queueDestroy(default_queue);
+    default_queue = NULL;
+}
+
+/*Mutex mode methods*/
+
+/**
+ * @brief Allocates a new mutex queue instance and initializes its item queue, thread queue, node pool and lock.
+ *
+ * Every instance owns its own lock, so operations on different queues never contend with each other.
+ * The node pool is prewarmed according to the configuration so the steady state hot path recycles
+ * QueueElem wrappers instead of allocating them. Values are copied into their wrappers, so a wrapper spans
+ * its header and element_size value bytes. ThreadNodes live on the stacks of their waiting threads.
+ *
+ * @param config The configuration of the new queue instance.
+ *
+ * @return A pointer to the new queue instance, or NULL if memory allocation failed.
+ *
+ * @note Used by queueCreateWithConfig.
+ *
+ */
+static ConcurrentQueue* mutex_queue_create(const QueueConfig *config) {
     // Variable declaration
-    void *item_to_return;
+    MutexQueue *queue;
 
-    mtx_lock(&queue_lock);
+    queue = malloc(sizeof(MutexQueue));
+    if (queue == NULL) {
+        return NULL;
+    }
 
-    deal_with_empty_queue();
-    item_to_return = item_dequeue_impl();
+    init_item_queue(&queue->item_queue, config);
 
-    mtx_unlock(&queue_lock);
+    init_thread_queue(&queue->thread_queue);
 
-    return item_to_return;
+    if (!node_pool_init(&queue->item_pool, sizeof(QueueElem) + config->element_size, config->pool_prewarm,
+                        config->pool_max_retained)) {
+        free(queue);
+        return NULL;
+    }
+
+    if (mtx_init(&queue->queue_lock, mtx_plain) != thrd_success) {
+        node_pool_destroy(&queue->item_pool);
+        free(queue);
+        return NULL;
+    }
+    if (cnd_init(&queue->batch_condition) != thrd_success) {
+        mtx_destroy(&queue->queue_lock);
+        node_pool_destroy(&queue->item_pool);
+        free(queue);
+        return NULL;
+    }
+    queue->batch_waiters = 0;
+    queue->wait_mode = config->wait_mode;
+    queue->spin_budget = config->spin_budget;
+    queue->base.ops = &mutex_ops;
+    return &queue->base;
+}
+
+/**
+ * @brief Hands a value to the first waiting thread if one exists, otherwise enqueues it into the item queue.
+ *
+ * The method starts by an attempt at locking. If a thread is waiting the value is copied directly to the
+ * thread's destination, so the value never enters the item queue and no other thread can take it on the way. The
+ * thread is woken up only after the queue's lock was released, and since it already holds its value
+ * it returns without taking the queue's lock again. Otherwise a wrapper is taken from the node pools and added to the item queue. Hence
+ * the item queue only holds items while no thread is waiting, and every item in it is free to dequeue.
+ *
+ * @param base The queue instance to enqueue into.
+ * @param element_to_enqueue  A pointer to the value the user wants to enqueue.
+ *
+ * @return True if the element was enqueued, false if its wrapper could not be allocated.
+ *
+ * @note Used through mutex_ops.
+ *
+ */
+static bool mutex_enqueue(ConcurrentQueue *base, const void *element_to_enqueue) {
+    return mutex_enqueue_priority(base, element_to_enqueue, 0);
+}
+
+/**
+ * @brief Enqueues a value into the lane of the given priority, handing it to the first waiting thread if
+ * one exists.
+ *
+ * Threads only wait while every lane is empty, so a handed value is always the most urgent one.
+ *
+ * @param base The queue instance to enqueue into.
+ * @param element_to_enqueue  A pointer to the value the user wants to enqueue.
+ * @param priority The lane of the value, clamped to the queue's highest lane.
+ *
+ * @return True if the element was enqueued, false if its wrapper could not be allocated.
+ *
+ * @note Used through mutex_ops and by mutex_enqueue.
+ *
+ */
+static bool mutex_enqueue_priority(ConcurrentQueue *base, const void *element_to_enqueue, unsigned int priority) {
+    // Variable declaration
+    MutexQueue *queue = (MutexQueue*)base;
+    QueueElem *new_element;
+    ThreadNode *served_thread;
+
+    if (priority >= queue->item_queue.lane_amount) {
+        priority = queue->item_queue.lane_amount - 1;
+    }
+
+    queue_stats_lock(queue->base.stats, &queue->queue_lock);
+
+    if (queue->thread_queue.queue_size > 0) {
+        served_thread = hand_item_to_waiting_thread(queue, element_to_enqueue);
+        mtx_unlock(&queue->queue_lock);
+        wake_served_thread(queue, served_thread);
+        return true;
+    }
+
+    new_element = init_item(queue, element_to_enqueue);
+    if (new_element == NULL) {
+        mtx_unlock(&queue->queue_lock);
+        return false;
+    }
+    add_element_to_item_queue(queue, new_element, priority);
+    wake_batch_waiters(queue);
+
+    mtx_unlock(&queue->queue_lock);
+    return true;
+}
+
+/**
+ * @brief Tries to dequeue an element from the item queue. If queue is empty, sleeps until an element
+ * is handed to it.
+ *
+ * If the item queue is not empty its head is dequeued. Otherwise a helper method deals with the empty queue
+ * by enqueueing the thread into the thread queue with a unique CV and releasing the queue's lock. This
+ * insures that the next enqueued items are handed to the waiting threads in FIFO order.
+ *
+ * @param base The queue instance to dequeue from.
+ * @param value A pointer to the location in which to save the dequeued value.
+ *
+ * @note Used through mutex_ops.
+ *
+ */
+static void mutex_dequeue(ConcurrentQueue *base, void *value) {
+    // Variable declaration
+    MutexQueue *queue = (MutexQueue*)base;
+
+    queue_stats_lock(queue->base.stats, &queue->queue_lock);
+
+    if (queue->item_queue.queue_size == 0) {
+        deal_with_empty_queue(queue, value);
+        return;
+    }
+    item_dequeue_impl(queue, value);
+
+    mtx_unlock(&queue->queue_lock);
 }
 
 /**
  * @brief Tries to dequeue an element with out blocking. If possible saves it into the provided pointer
  * and returns true, otherwise returns false.
  *
- * The method checks if there are more enqueued elements then threads waiting. If there are it dequeues the first element
- * that does not have a thread waiting to dequeue it (the first element in a larger position then the amount of waiting 
- * threads). If there are no waiting threads it just dequeues the head of the queue normally.
+ * Since items are handed directly to waiting threads, no item in the item queue is reserved for a sleeping
+ * thread. Hence the head can always be taken, in constant time regardless of the amount of waiting threads.
  *
- * @param item_of_element_to_dequeue A pointer to the location in memory in which to save the dequeued item, if able to.
+ * @param base The queue instance to dequeue from.
+ * @param item_of_element_to_dequeue A pointer to the location in memory in which to save the dequeued value, if able to.
  * ...
  * @return True if an element was successfully dequeued, other wise false.
  *
+ * @note Used through mutex_ops.
+ *
  */
-bool tryDequeue(void **item_of_element_to_dequeue) {
+static bool mutex_try_dequeue(ConcurrentQueue *base, void *item_of_element_to_dequeue) {
     // Variable declaration
-    QueueElem *dequeued_element;
+    MutexQueue *queue = (MutexQueue*)base;
+
+    queue_stats_lock(queue->base.stats, &queue->queue_lock);
+
+    if (queue->item_queue.queue_size > 0) {
+        item_dequeue_impl(queue, item_of_element_to_dequeue);
+        mtx_unlock(&queue->queue_lock);
+        return true;
+    }
+    mtx_unlock(&queue->queue_lock);
+    return false;
+}
+
+/**
+ * @brief Enqueues several items into the item queue under a single lock acquisition.
+ *
+ * The first items are handed to waiting threads, one item per thread in FIFO order, and those threads are
+ * woken up once the queue's lock was released. The wrappers of the remaining items are linked into a private chain which is spliced onto the tail at once, and batch
+ * waiters are notified.
+ *
+ * @param base The queue instance to enqueue into.
+ * @param values The values to enqueue, in FIFO order.
+ * @param amount The amount of values.
+ *
+ * @return The amount of items enqueued, less than amount only if a wrapper could not be allocated.
+ *
+ * @note Used through mutex_ops.
+ *
+ */
+static size_t mutex_enqueue_batch(ConcurrentQueue *base, const void *values, size_t amount) {
+    // Variable declaration
+    MutexQueue *queue = (MutexQueue*)base;
+    const unsigned char *value_bytes = values;
+    QueueElem *first_element = NULL;
+    QueueElem *last_element = NULL;
+    QueueElem *new_element;
+    ThreadNode *first_served = NULL;
+    ThreadNode *last_served = NULL;
+    ThreadNode *served_thread;
+    size_t enqueued_amount = 0;
+    size_t handed_amount;
 
-    mtx_lock(&queue_lock);
+    queue_stats_lock(queue->base.stats, &queue->queue_lock);
 
-    if (item_queue->queue_size > thread_queue->queue_size) {
-        if (thread_queue->queue_size == 0) {
-            *item_of_element_to_dequeue = item_dequeue_impl();
+    while (enqueued_amount < amount && queue->thread_queue.queue_size > 0) {
+        served_thread = hand_item_to_waiting_thread(queue, value_bytes + enqueued_amount * base->element_size);
+        served_thread->next = NULL;
+        if (first_served == NULL) {
+            first_served = served_thread;
         }
         else {
-            dequeued_element = dequeue_first_non_acquired_element(thread_queue->queue_size);
-            *item_of_element_to_dequeue = dequeued_element->item;
-            free(dequeued_element);
+            last_served->next = served_thread;
         }
-        mtx_unlock(&queue_lock);
-        return true;
+        last_served = served_thread;
+        enqueued_amount++;
     }
-    mtx_unlock(&queue_lock);
-    return false;
+    handed_amount = enqueued_amount;
+
+    for (; enqueued_amount < amount; enqueued_amount++) {
+        new_element = init_item(queue, value_bytes + enqueued_amount * base->element_size);
+        if (new_element == NULL) {
+            break;
+        }
+        if (first_element == NULL) {
+            first_element = new_element;
+        }
+        else {
+            last_element->next = new_element;
+        }
+        last_element = new_element;
+    }
+
+    if (enqueued_amount > handed_amount) {
+        add_chain_to_item_queue(queue, first_element, last_element, (int)(enqueued_amount - handed_amount), 0);
+        wake_batch_waiters(queue);
+    }
+
+    mtx_unlock(&queue->queue_lock);
+
+    // A woken thread may return and release its node at once, so the next node is read beforehand
+    while (first_served != NULL) {
+        served_thread = first_served;
+        first_served = served_thread->next;
+        wake_served_thread(queue, served_thread);
+    }
+    return enqueued_amount;
+}
+
+/**
+ * @brief Dequeues up to max_items items under a single lock acquisition, lingering until min_items items
+ * are free or the deadline passed.
+ *
+ * Items are handed directly to threads sleeping in the thread queue, so every item in the item queue is
+ * free to take. Batch waiters sleep on a condition variable shared by the queue and re-check the amount of
+ * items whenever an enqueue notifies them.
+ *
+ * @param base The queue instance to dequeue from.
+ * @param values The array in which to save the dequeued values.
+ * @param max_items The maximal amount of items to dequeue.
+ * @param min_items The amount of items to wait for.
+ * @param deadline An absolute TIME_UTC deadline, or NULL to wait for min_items indefinitely.
+ *
+ * @return The amount of items dequeued.
+ *
+ * @note Used through mutex_ops.
+ *
+ */
+static size_t mutex_dequeue_batch(ConcurrentQueue *base, void *values, size_t max_items, size_t min_items,
+                                  const struct timespec *deadline) {
+    // Variable declaration
+    MutexQueue *queue = (MutexQueue*)base;
+    unsigned char *value_bytes = values;
+    size_t dequeued_amount = 0;
+    int wait_result = thrd_success;
+    uint64_t trace_start;
+
+    queue_stats_lock(queue->base.stats, &queue->queue_lock);
+
+    while ((size_t)queue->item_queue.queue_size < min_items && wait_result != thrd_timedout) {
+        queue->batch_waiters++;
+        queue_stats_parked(queue->base.stats, 1);
+        trace_start = queue_trace_begin();
+        if (deadline == NULL) {
+            wait_result = cnd_wait(&queue->batch_condition, &queue->queue_lock);
+        }
+        else {
+            wait_result = cnd_timedwait(&queue->batch_condition, &queue->queue_lock, deadline);
+        }
+        queue_trace_end(QUEUE_TRACE_PARK, queue, trace_start);
+        queue_stats_parked(queue->base.stats, -1);
+        queue->batch_waiters--;
+    }
+
+    while (dequeued_amount < max_items && queue->item_queue.queue_size > 0) {
+        item_dequeue_impl(queue, value_bytes + dequeued_amount * base->element_size);
+        dequeued_amount++;
+    }
+
+    mtx_unlock(&queue->queue_lock);
+    return dequeued_amount;
 }
 
 /**
  * @brief Returns the amount of elements that where enqueued and then dequeued.
  *
+ * @param base The queue instance to query.
+ *
  * @return  Returns the amount of elements that where enqueued and then dequeued saved in the 
- * visisted field of the Queue struct.
+ * visisted field of the Queue struct. The field is atomic, so it is read without the lock and without
+ * tearing.
  * 
+ * @note Used through mutex_ops.
+ *
  */
-size_t visited(void) {
-    return item_queue->visited_items;
+static size_t mutex_visited(ConcurrentQueue *base) {
+    // Variable declaration
+    MutexQueue *queue = (MutexQueue*)base;
+
+    return atomic_load_explicit(&queue->item_queue.visited_items, memory_order_relaxed);
 }
 
 /**
- * @brief Destroys the item queue, thread queue and lock. 
+ * @brief Destroys the item queue, thread queue and lock of a queue instance. 
+ *
+ * Iterates through both queues and releases all elements, dropping their values, then frees the node pools,
+ * the lock and the instance itself. ThreadNodes belong to their waiting threads and are only unlinked.
  *
- * Iterates through both queues and dequeues all elements, then frees them, the queues themselves and the lock.
+ * @param base The queue instance to destroy.
+ *
+ * @note Used through mutex_ops.
  *
  */
-void destroyQueue(void) {
+static void mutex_destroy(ConcurrentQueue *base) {
     // Variable declaration
+    MutexQueue *queue = (MutexQueue*)base;
+    QueueElem *current_element;
+    QueueElem *next_element;
+    unsigned int lane_index;
     int i;
-    int amount_of_items; 
     int amount_of_threads;
 
 
-    mtx_lock(&queue_lock);
+    mtx_lock(&queue->queue_lock);
 
-    amount_of_items = item_queue->queue_size;
-    for (i = 0; i < amount_of_items; i++){
-        item_dequeue_impl();
+    for (lane_index = 0; lane_index < queue->item_queue.lane_amount; lane_index++) {
+        current_element = queue->item_queue.lanes[lane_index].head;
+        while (current_element != NULL) {
+            next_element = current_element->next;
+            node_pool_release(&queue->item_pool, current_element);
+            current_element = next_element;
+        }
     }
     
-    amount_of_threads = thread_queue->queue_size;
+    amount_of_threads = queue->thread_queue.queue_size;
     for (i = 0; i < amount_of_threads; i++){
-        thread_dequeue();
+        thread_dequeue(queue);
+    }
+
+    node_pool_destroy(&queue->item_pool);
+
+    mtx_unlock(&queue->queue_lock);
+    cnd_destroy(&queue->batch_condition);
+    mtx_destroy(&queue->queue_lock);
+    free(queue);
+}
+
+/*Batch fallback methods*/
+
+/**
+ * @brief Enqueues several items one by one, for modes without a batch enqueue operation.
+ *
+ * @note Used by queueEnqueueBatch.
+ *
+ */
+static size_t enqueue_batch_fallback(ConcurrentQueue *queue, const void *values, size_t amount) {
+    // Variable declaration
+    const unsigned char *value_bytes = values;
+    size_t enqueued_amount;
+
+    for (enqueued_amount = 0; enqueued_amount < amount; enqueued_amount++) {
+        if (!queue->ops->enqueue(queue, value_bytes + enqueued_amount * queue->element_size)) {
+            break;
+        }
     }
+    return enqueued_amount;
+}
+
+/**
+ * @brief Dequeues several items one by one, for modes without a batch dequeue operation.
+ *
+ * Without a deadline the missing items up to min_items are taken with the blocking dequeue. With a deadline
+ * the mode offers nothing to wait on, so the queue is polled every QUEUE_BATCH_POLL_INTERVAL_NS until
+ * min_items were collected or the deadline passed. Either way the batch is then topped up to max_items
+ * with non blocking dequeues.
+ *
+ * @note Used by queueDequeueBatch.
+ *
+ */
+static size_t dequeue_batch_fallback(ConcurrentQueue *queue, void *values, size_t max_items, size_t min_items,
+                                     const struct timespec *deadline) {
+    // Variable declaration
+    unsigned char *value_bytes = values;
+    size_t dequeued_amount = 0;
+    struct timespec poll_interval = {0, QUEUE_BATCH_POLL_INTERVAL_NS};
 
-    free(item_queue);
-    free(thread_queue);
+    while (dequeued_amount < min_items) {
+        if (queue->ops->try_dequeue(queue, value_bytes + dequeued_amount * queue->element_size)) {
+            dequeued_amount++;
+        }
+        else if (deadline == NULL) {
+            queue->ops->dequeue(queue, value_bytes + dequeued_amount * queue->element_size);
+            dequeued_amount++;
+        }
+        else if (deadline_passed(deadline)) {
+            break;
+        }
+        else {
+            thrd_sleep(&poll_interval, NULL);
+        }
+    }
 
-    mtx_unlock(&queue_lock);
-    mtx_destroy(&queue_lock);
+    while (dequeued_amount < max_items &&
+           queue->ops->try_dequeue(queue, value_bytes + dequeued_amount * queue->element_size)) {
+        dequeued_amount++;
+    }
+    return dequeued_amount;
+}
+
+/**
+ * @brief Checks whether an absolute TIME_UTC deadline passed.
+ *
+ * @note Used by dequeue_batch_fallback.
+ *
+ */
+static bool deadline_passed(const struct timespec *deadline) {
+    // Variable declaration
+    struct timespec now;
+
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
 }
 
 /*Private methods*/
 
 /**
- * @brief Initializes the global item queue instance.
+ * @brief Counts a dequeued or handed over item in the visited field of the item queue.
  *
- * @note Used by initQueue.
+ * Only threads holding the queue's lock write the field, so a relaxed load and store suffice, while
+ * mutex_visited reads it without the lock.
+ *
+ * @param item_queue The item queue whose visited field to increment.
+ *
+ * @note Used by hand_item_to_waiting_thread and item_dequeue_impl.
  *
  */
-static void init_item_queue() {
-    item_queue = malloc(sizeof(Queue));
-    item_queue->head = NULL;
-    item_queue->tail = NULL;
+static void count_visited_item(Queue *item_queue) {
+    atomic_store_explicit(&item_queue->visited_items,
+                          atomic_load_explicit(&item_queue->visited_items, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+/**
+ * @brief Initializes the item queue of a queue instance with the configured amount of priority lanes.
+ *
+ * @param item_queue A pointer to the item queue to initialize.
+ * @param config The configuration whose priority_lanes and priority_aging to use.
+ *
+ * @note Used by mutex_queue_create.
+ *
+ */
+static void init_item_queue(Queue *item_queue, const QueueConfig *config) {
+    // Variable declaration
+    unsigned int lane_index;
+
+    for (lane_index = 0; lane_index < QUEUE_MAX_PRIORITY_LANES; lane_index++) {
+        item_queue->lanes[lane_index].head = NULL;
+        item_queue->lanes[lane_index].tail = NULL;
+        item_queue->lanes[lane_index].served_stamp = 0;
+    }
+    item_queue->lane_amount = config->priority_lanes;
+    if (item_queue->lane_amount == 0) {
+        item_queue->lane_amount = 1;
+    }
+    else if (item_queue->lane_amount > QUEUE_MAX_PRIORITY_LANES) {
+        item_queue->lane_amount = QUEUE_MAX_PRIORITY_LANES;
+    }
+    item_queue->aging = config->priority_aging;
+    item_queue->lane_mask = 0;
     item_queue->queue_size = 0;   
-    item_queue->visited_items = 0; 
+    item_queue->dequeue_count = 0;
+    atomic_init(&item_queue->visited_items, 0);
 }
 
 /**
- * @brief Initializes the global thread queue instance.
+ * @brief Initializes the thread queue of a queue instance.
+ *
+ * @param thread_queue A pointer to the thread queue to initialize.
  *
- * @note Used by initQueue.
+ * @note Used by mutex_queue_create.
  *
  */
-static void init_thread_queue() {
-    thread_queue = malloc(sizeof(ThreadQueue));
+static void init_thread_queue(ThreadQueue *thread_queue) {
     thread_queue->head = NULL;
     thread_queue->tail = NULL;
     thread_queue->queue_size = 0;   
 }
 
 /**
- * @brief Initializes a QueueElem instance with the given element as the item.
+ * @brief Initializes a QueueElem instance holding a copy of the given value.
  *
- * @param element_to_enqueue A pointer to the element to be enqueued.
+ * The wrapper is taken from the calling thread's node cache and, if it is empty, from the item pool,
+ * which only falls back to the heap once it runs dry.
+ *
+ * @param queue The queue instance whose item pool to allocate from.
+ * @param element_to_enqueue A pointer to the value to be enqueued.
  * ...
- * @return A QueueElem struct instance with element_to_enqueue as the item.
+ * @return A QueueElem struct instance holding the value, or NULL if allocation failed.
  *
- * @note Used by enqueue.
+ * @note Used by mutex_enqueue and mutex_enqueue_batch.
  *
  */
-static QueueElem* init_item(void *element_to_enqueue) {
+static QueueElem* init_item(MutexQueue *queue, const void *element_to_enqueue) {
     // Variable declaration
     QueueElem *new_element;
 
-    new_element = malloc(sizeof(QueueElem));
-    new_element->item = element_to_enqueue;
+    new_element = node_cache_take(queue->item_pool.node_size);
+    if (new_element == NULL) {
+        new_element = node_pool_alloc(&queue->item_pool);
+    }
+    if (new_element == NULL) {
+        return NULL;
+    }
+    queue_copy_value(new_element->value, element_to_enqueue, queue->base.element_size);
+    new_element->enqueue_time = queue_stats_sample_time(queue->base.stats);
     new_element->next = NULL;
 
     return new_element;
 }
 
 /**
- * @brief Adds an element to the appropriate position in the item queue.
+ * @brief Adds an element to the appropriate position in a lane of the item queue.
  * 
- * Adds an element created by init_item to the head of the queue if it is empty, 
- * other wise to the tail.
+ * Adds an element created by init_item to the head of the lane if it is empty, 
+ * other wise to the tail. A lane that becomes non empty sets its bit in the lane mask and starts aging
+ * from the current dequeue count.
  *
+ * @param queue The queue instance whose item queue to add to.
  * @param element_to_add A pointer to the QueueElem instance generated by init_item.
+ * @param lane_index The lane to add to, below the queue's amount of lanes.
  *
- * @note Used by enqueue.
+ * @note Used by mutex_enqueue_priority.
  *
  */
-static void add_element_to_item_queue(QueueElem *element_to_add) {
-    if (item_queue->queue_size == 0) {
-        item_queue->head = element_to_add;
-        item_queue->tail = element_to_add;
-        item_queue->queue_size++;
-    }
+static void add_element_to_item_queue(MutexQueue *queue, QueueElem *element_to_add, unsigned int lane_index) {
+    add_chain_to_item_queue(queue, element_to_add, element_to_add, 1, lane_index);
+}
 
+/**
+ * @brief Splices a chain of linked QueueElem instances onto a lane of the item queue in one step.
+ *
+ * @param queue The queue instance whose item queue to add to.
+ * @param first_element The first element of the chain.
+ * @param last_element The last element of the chain, whose next field is NULL.
+ * @param amount The amount of elements in the chain.
+ * @param lane_index The lane to add to, below the queue's amount of lanes.
+ *
+ * @note Used by mutex_enqueue_batch and add_element_to_item_queue.
+ *
+ */
+static void add_chain_to_item_queue(MutexQueue *queue, QueueElem *first_element, QueueElem *last_element, int amount,
+                                    unsigned int lane_index) {
+    // Variable declaration
+    Queue *item_queue = &queue->item_queue;
+    Lane *lane = &item_queue->lanes[lane_index];
+
+    if (lane->head == NULL) {
+        lane->head = first_element;
+        lane->served_stamp = item_queue->dequeue_count;
+        item_queue->lane_mask |= 1u << lane_index;
+    }
     else {
-        item_queue->tail->next = element_to_add;
-        item_queue->tail = element_to_add;
-        item_queue->queue_size++;
+        lane->tail->next = first_element;
     }
+    lane->tail = last_element;
+    item_queue->queue_size += amount;
+    queue_stats_record_depth(queue->base.stats, (size_t)item_queue->queue_size);
 }
 
 /**
- * @brief Checks if a thread is waiting to dequeue an elmenet from the item queue and wakes it up if it is.
+ * @brief Hands a value to the first thread waiting in the thread queue.
  * 
- * @return A QueueElem struct instance with element_to_enqueue as the item.
+ * The value is copied to the destination of the thread's ThreadNode, which is unlinked from the thread queue.
+ * The thread is blocked until it is marked as served, so its destination can be written without further
+ * synchronization. The item counts as
+ * visited at this point since it never enters the item queue, and if it is sampled its sojourn time is
+ * recorded as the time it takes to hand it over. The thread itself is woken up by
+ * wake_served_thread once the caller released the queue's lock.
+ *
+ * @param queue The queue instance whose thread queue to serve, which must not be empty.
+ * @param element_to_enqueue A pointer to the value to hand over.
+ *
+ * @return The ThreadNode of the served thread.
  *
- * @note Used by enqueue.
+ * @note Used by mutex_enqueue and mutex_enqueue_batch.
  *
  */
-static void check_for_waiting_threads() {
+static ThreadNode* hand_item_to_waiting_thread(MutexQueue *queue, const void *element_to_enqueue) {
     // Variable declaration
-    cnd_t *thread_to_wake;
+    ThreadNode *served_thread;
+
+    served_thread = thread_dequeue(queue);
+    queue_copy_value(served_thread->destination, element_to_enqueue, queue->base.element_size);
+    count_visited_item(&queue->item_queue);
+    queue_stats_record_sojourn(queue->base.stats, queue_stats_sample_time(queue->base.stats));
+    return served_thread;
+}
+
+/**
+ * @brief Marks a ThreadNode as served and wakes up its thread.
+ * 
+ * In QUEUE_WAIT_CONDVAR only the node's own lock is taken, so the woken thread competes with nobody but the
+ * waker for it and never with the other users of the queue. The signal is sent while the node's lock is
+ * held, hence the waiting thread can not observe the served flag, return and destroy its node before the
+ * waker is done with it.
+ *
+ * In QUEUE_WAIT_SPIN_FUTEX the node's state is swapped to THREAD_SERVED and the futex is only woken if the
+ * thread already went to sleep, so a thread served while spinning costs no system call. The wake may reach
+ * a node whose thread already returned, which at worst causes a spurious wake up that every futex waiter
+ * re-checks anyway.
+ *
+ * @param queue The queue instance the thread is waiting on.
+ * @param served_thread The ThreadNode returned by hand_item_to_waiting_thread.
+ *
+ * @note Used by mutex_enqueue and mutex_enqueue_batch.
+ *
+ */
+static void wake_served_thread(MutexQueue *queue, ThreadNode *served_thread) {
+    if (queue->wait_mode == QUEUE_WAIT_SPIN_FUTEX) {
+        if (atomic_exchange_explicit(&served_thread->state, THREAD_SERVED, memory_order_release) == THREAD_PARKED) {
+            futex_wake(&served_thread->state, 1);
+        }
+        return;
+    }
+
+    mtx_lock(&served_thread->handoff_lock);
+    served_thread->served = true;
+    cnd_signal(&served_thread->condition);
+    mtx_unlock(&served_thread->handoff_lock);
+    queue_trace_instant(QUEUE_TRACE_WAKE, served_thread, 1);
+}
 
-    if (thread_queue->queue_size > 0) { 
-        thread_to_wake = thread_dequeue(); 
-        cnd_signal(thread_to_wake);
+/**
+ * @brief Wakes up every thread lingering in a batch dequeue so it can re-check the amount of free items.
+ *
+ * Batch waiters wait for different amounts of items, so all of them are woken. They are rare compared to
+ * single item waiters, which keep being woken one at a time.
+ *
+ * @param queue The queue instance whose batch waiters to wake.
+ *
+ * @note Used by mutex_enqueue and mutex_enqueue_batch.
+ *
+ */
+static void wake_batch_waiters(MutexQueue *queue) {
+    if (queue->batch_waiters > 0) {
+        cnd_broadcast(&queue->batch_condition);
+        queue_trace_instant(QUEUE_TRACE_WAKE, queue, 1);
     }
 }
 
 /**
- * @brief Checks if the queue is empty, adds a condition variable to the thread queue and calls wait on it.
+ * @brief Adds a ThreadNode to the thread queue and waits on it until an item is handed over.
  * 
- * The method first checks if the queue is empty. If it is it initializes a unique CV for the current thread and 
- * initializes it. Then it enqueues it into the thread queue using a helper method and calls wait on it. Lastly
- * it destroys the CV upon wake up. This insures threads wake up in FIFO order since their unique CVs are
- * kept in a queue.
+ * The method initializes a ThreadNode on the current thread's stack, enqueues it into the thread queue using
+ * a helper method and releases the queue's lock. Then it waits, according to the queue's wait mode, until an
+ * enqueueing thread marks the node as served. The value was already copied to the caller's location by then,
+ * so the queue's lock is not taken again on the way out. This insures threads are served in FIFO order since
+ * their ThreadNodes are kept in a queue.
+ *
+ * @param queue The queue instance the current thread is dequeueing from, whose item queue is empty and whose
+ * lock is held by the caller. The lock is released by this method.
+ * @param value A pointer to the location in which the enqueuer saves the handed value.
  *
- * @note Used by dequeue.
+ * @note Used by mutex_dequeue.
  *
  */
-static void deal_with_empty_queue() {
+static void deal_with_empty_queue(MutexQueue *queue, void *value) {
     // Variable declaration
-    cnd_t current_thread_cond;
+    ThreadNode current_thread_node;
 
-    if (item_queue->queue_size == 0) {
-        cnd_init(&current_thread_cond);
-        thread_enqueue(&current_thread_cond);
-        cnd_wait(&current_thread_cond, &queue_lock);
-        cnd_destroy(&current_thread_cond);
+    init_thread_node(queue, &current_thread_node);
+    current_thread_node.destination = value;
+    thread_enqueue(queue, &current_thread_node);
+    queue_stats_parked(queue->base.stats, 1);
+    mtx_unlock(&queue->queue_lock);
+
+    if (queue->wait_mode == QUEUE_WAIT_SPIN_FUTEX) {
+        spin_then_park(queue, &current_thread_node);
     }
+    else {
+        wait_on_condition(&current_thread_node);
+    }
+    queue_stats_parked(queue->base.stats, -1);
+}
 
+/**
+ * @brief Waits on a ThreadNode's CV until it is marked as served, then destroys its lock and CV.
+ *
+ * Waiting until the served flag is set also protects against spurious wake ups.
+ *
+ * @param thread_node The current thread's ThreadNode, initialized in QUEUE_WAIT_CONDVAR.
+ *
+ * @note Used by deal_with_empty_queue.
+ *
+ */
+static void wait_on_condition(ThreadNode *thread_node) {
+    // Variable declaration
+    uint64_t trace_start = queue_trace_begin();
+
+    mtx_lock(&thread_node->handoff_lock);
+    while (!thread_node->served) {
+        cnd_wait(&thread_node->condition, &thread_node->handoff_lock);
+    }
+    mtx_unlock(&thread_node->handoff_lock);
+    queue_trace_end(QUEUE_TRACE_PARK, thread_node, trace_start);
+
+    cnd_destroy(&thread_node->condition);
+    mtx_destroy(&thread_node->handoff_lock);
 }
 
 /**
- * @brief Dequeues an element from the item queue, frees its wrapper QueueElem and returns it.
- * 
- * This method dequeues a QueueElem instance from the item queue. Then it chekcs if the queue is empty and, if it
- * is, it sets its tail to NULL. then it frees the wrapper QueueElem and returns its item field.
+ * @brief Spins on a ThreadNode's state for up to the queue's spin budget, then sleeps on it as a futex.
  *
- * @return The item filed of the dequeued element.
+ * Items often arrive within microseconds, in which case the thread is served while spinning and never
+ * enters the kernel. Otherwise the state is moved from THREAD_WAITING to THREAD_PARKED, telling the waker
+ * to issue a futex wake, and the thread sleeps until the state becomes THREAD_SERVED. If the compare and
+ * swap fails the node was served in the meantime.
  *
- * @note Used by dequeue, tryDequeue and destroyQueue.
+ * @param queue The queue instance whose spin budget to use.
+ * @param thread_node The current thread's ThreadNode, initialized in QUEUE_WAIT_SPIN_FUTEX.
+ *
+ * @note Used by deal_with_empty_queue.
  *
  */
-static void* item_dequeue_impl() {
+static void spin_then_park(MutexQueue *queue, ThreadNode *thread_node) {
     // Variable declaration
-    QueueElem *dequeued_element;
-    void *item_to_return;
+    unsigned int spins;
+    unsigned int expected_state = THREAD_WAITING;
 
-    dequeued_element = item_queue->head;
-    item_queue->head = dequeued_element->next; 
-    item_queue->queue_size--;
-    item_queue->visited_items++;
+    for (spins = 0; spins < queue->spin_budget; spins++) {
+        if (atomic_load_explicit(&thread_node->state, memory_order_acquire) == THREAD_SERVED) {
+            return;
+        }
+        queue_cpu_relax();
+    }
 
-    if (item_queue->queue_size == 0) {
-        item_queue->tail = NULL;
+    if (!atomic_compare_exchange_strong_explicit(&thread_node->state, &expected_state, THREAD_PARKED,
+                                                 memory_order_acquire, memory_order_acquire)) {
+        return;
+    }
+    while (atomic_load_explicit(&thread_node->state, memory_order_acquire) != THREAD_SERVED) {
+        futex_wait(&thread_node->state, THREAD_PARKED);
     }
-    item_to_return = dequeued_element->item;
-    free(dequeued_element);
-    return item_to_return;
 }
 
 /**
- * @brief Enqueues a threads unique CV into the thread queue.
+ * @brief Dequeues an element from the item queue, copies its value out and recycles its wrapper QueueElem.
  * 
- * Uses a helper method to wrap the CV into a ThreadNode struct instance, then uses another one to 
- * add it to the thread queue.
+ * This method dequeues a QueueElem instance from the lane picked by select_lane. Then it chekcs if the lane is
+ * empty and, if it is, it sets its tail to NULL and clears its bit in the lane mask. then it copies out the value
+ * and releases the wrapper QueueElem to the node pools.
  *
- * @param condition A pointer to the condition variable unique to the current thread.
+ * @param queue The queue instance to dequeue from.
+ * @param value A pointer to the location in which to save the value of the dequeued element.
+ *
+ * @note Used by mutex_dequeue, mutex_try_dequeue and mutex_dequeue_batch.
  *
- * @note Used by deal_with_empty_queue.
  */
-static void thread_enqueue(cnd_t *condition) {
+static void item_dequeue_impl(MutexQueue *queue, void *value) {
     // Variable declaration
-    ThreadNode *new_element;
+    Queue *item_queue = &queue->item_queue;
+    QueueElem *dequeued_element;
+    unsigned int lane_index;
+    Lane *lane;
+
+    lane_index = select_lane(item_queue);
+    lane = &item_queue->lanes[lane_index];
+    dequeued_element = lane->head;
+    lane->head = dequeued_element->next; 
+    item_queue->queue_size--;
+    item_queue->dequeue_count++;
+    lane->served_stamp = item_queue->dequeue_count;
+    count_visited_item(item_queue);
 
-    new_element = init_thread_node(condition);
-    add_element_to_thread_queue(new_element);
+    if (lane->head == NULL) {
+        lane->tail = NULL;
+        item_queue->lane_mask &= ~(1u << lane_index);
+    }
+    queue_copy_value(value, dequeued_element->value, queue->base.element_size);
+    queue_stats_record_sojourn(queue->base.stats, dequeued_element->enqueue_time);
+    node_pool_release(&queue->item_pool, dequeued_element);
 }
 
 /**
- * @brief Initializes a ThreadNode struct instance with the provided CV in the condition field.
+ * @brief Picks the lane the next dequeue takes from.
  *
- * @param condition A pointer to the condition variable unique to the current thread.
- * 
- * @return A ThreadNode instance with condition in its condition field.
+ * Normally this is the highest non empty lane, found in the lane mask with a single bit scan. With aging
+ * enabled, a non empty lower lane that was passed over by aging dequeues since it was last served (or
+ * became non empty) is starved and taken first, the one waiting longest if several are. Hence every non
+ * empty lane is served at least once in about every aging + 1 dequeues, whatever the load of the lanes
+ * above it.
  *
- * @note Used by thread_enqueue.
+ * @param item_queue The item queue, which must not be empty.
+ *
+ * @return The index of the lane to take from.
+ *
+ * @note Used by item_dequeue_impl.
  *
  */
-static ThreadNode* init_thread_node(cnd_t *condition) {
+static unsigned int select_lane(Queue *item_queue) {
     // Variable declaration
-    ThreadNode *new_element;
+    unsigned int selected_lane;
+    unsigned int lane_index;
+    unsigned int remaining_lanes;
+    size_t oldest_stamp;
 
-    new_element = malloc(sizeof(ThreadNode));
-    new_element->condition = condition;
-    new_element->next = NULL;
+    selected_lane = 31 - (unsigned int)__builtin_clz(item_queue->lane_mask);
+    if (item_queue->aging == 0) {
+        return selected_lane;
+    }
 
-    return new_element;
+    remaining_lanes = item_queue->lane_mask & ~(1u << selected_lane);
+    oldest_stamp = SIZE_MAX;
+    while (remaining_lanes != 0) {
+        lane_index = 31 - (unsigned int)__builtin_clz(remaining_lanes);
+        remaining_lanes &= ~(1u << lane_index);
+        if (item_queue->dequeue_count - item_queue->lanes[lane_index].served_stamp >= item_queue->aging &&
+            item_queue->lanes[lane_index].served_stamp < oldest_stamp) {
+            oldest_stamp = item_queue->lanes[lane_index].served_stamp;
+            selected_lane = lane_index;
+        }
+    }
+    return selected_lane;
+}
+
+/**
+ * @brief Enqueues a threads ThreadNode into the thread queue.
+ * 
+ * Uses a helper method to add the ThreadNode to the thread queue.
+ *
+ * @param queue The queue instance whose thread queue to enqueue into.
+ * @param thread_node A pointer to the ThreadNode unique to the current thread.
+ *
+ * @note Used by deal_with_empty_queue.
+ */
+static void thread_enqueue(MutexQueue *queue, ThreadNode *thread_node) {
+    add_element_to_thread_queue(queue, thread_node);
+}
+
+/**
+ * @brief Initializes a ThreadNode struct instance for the queue's wait mode.
+ *
+ * A fresh handoff lock and CV are only created in QUEUE_WAIT_CONDVAR, QUEUE_WAIT_SPIN_FUTEX only needs the
+ * state word.
+ *
+ * @param queue The queue instance whose wait mode to use.
+ * @param thread_node A pointer to the ThreadNode to initialize.
+ *
+ * @note Used by deal_with_empty_queue.
+ *
+ */
+static void init_thread_node(MutexQueue *queue, ThreadNode *thread_node) {
+    if (queue->wait_mode == QUEUE_WAIT_CONDVAR) {
+        mtx_init(&thread_node->handoff_lock, mtx_plain);
+        cnd_init(&thread_node->condition);
+    }
+    atomic_init(&thread_node->state, THREAD_WAITING);
+    thread_node->destination = NULL;
+    thread_node->served = false;
+    thread_node->next = NULL;
 }
 
 /**
@@ -385,12 +1482,16 @@ static ThreadNode* init_thread_node(cnd_t *condition) {
  * Adds an ThreadNode created by init_thread_node to the head of the thread queue if it is empty, 
  * other wise to the tail.
  *
- * @param element_to_add A pointer to the ThreadNode instance generated by init_item.
+ * @param queue The queue instance whose thread queue to add to.
+ * @param element_to_add A pointer to the ThreadNode instance initialized by init_thread_node.
  *
  * @note Used by thread_enqueue.
  *
  */
-static void add_element_to_thread_queue(ThreadNode *element_to_add) {
+static void add_element_to_thread_queue(MutexQueue *queue, ThreadNode *element_to_add) {
+    // Variable declaration
+    ThreadQueue *thread_queue = &queue->thread_queue;
+
     if (thread_queue->queue_size == 0) {
         thread_queue->head = element_to_add;
         thread_queue->tail = element_to_add;
@@ -405,20 +1506,23 @@ static void add_element_to_thread_queue(ThreadNode *element_to_add) {
 }
 
 /**
- * @brief Dequeues an element from the thread queue, frees its wrapper ThreadNode and returns it.
+ * @brief Dequeues an element from the thread queue and returns it.
  * 
  * This method dequeues a ThreadNode instance from the thread queue. Then it chekcs if the queue is empty and, if it
- * is, it sets its tail to NULL. then it frees the wrapper ThreadNode and returns its condition field.
+ * is, it sets its tail to NULL. The ThreadNode belongs to its waiting thread, which still has to read the item
+ * handed to it.
  *
- * @return The condition held in the ThreadNode wrappers condition field.
+ * @param queue The queue instance whose thread queue to dequeue from.
  *
- * @note Used by check_for_waiting_threads and destroyQueue.
+ * @return The dequeued ThreadNode.
+ *
+ * @note Used by hand_item_to_waiting_thread and mutex_destroy.
  *
  */
-static cnd_t* thread_dequeue() {
+static ThreadNode* thread_dequeue(MutexQueue *queue) {
     // Variable declaration
+    ThreadQueue *thread_queue = &queue->thread_queue;
     ThreadNode *dequeued_element;
-    cnd_t *item_to_return;
 
     dequeued_element = thread_queue->head;
     thread_queue->head = dequeued_element->next; 
@@ -428,40 +1532,7 @@ static cnd_t* thread_dequeue() {
     if (thread_queue->queue_size == 0) {
         thread_queue->tail = NULL;
     }
-    item_to_return = dequeued_element->condition;
-    free(dequeued_element);
-    return item_to_return;
-}
-
-/**
- * @brief Iterates through the item queue until finding the element in the index + 1 position. Then dequeues and
- * returns it.
- * 
- *
- * @param index The index of the position of the first "non-paired" element in the item queue (not paired
- * to a waiting thread that is).
- * 
- * @return The first QueueElem not paired to a waiting thread.
- *
- * @note Used by tryDequeue.
- *
- */
-static QueueElem* dequeue_first_non_acquired_element(int index) {
-    // Variable declaration
-    int i;
-    QueueElem *current_elem = item_queue->head;
-    QueueElem *element_to_return;
-
-    for (i = 1; i < index; i++) {
-        current_elem = current_elem->next;
-    }
-
-    element_to_return = current_elem->next;
-    current_elem->next = element_to_return->next;
-    item_queue->queue_size--;
-    item_queue->visited_items++;
-
-    return element_to_return;
+    return dequeued_element;
 }
 
 /* Used sources
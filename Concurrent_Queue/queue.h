@@ -0,0 +1,357 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+// Includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+// Constants
+#define QUEUE_DEFAULT_POOL_PREWARM 64
+#define QUEUE_DEFAULT_POOL_MAX_RETAINED 4096
+#define QUEUE_DEFAULT_RING_CAPACITY 1024
+#define QUEUE_DEFAULT_SEGMENT_CAPACITY 128
+#define QUEUE_DEFAULT_SPIN_BUDGET 2000
+#define QUEUE_DEFAULT_PRIORITY_AGING 32
+#define QUEUE_MAX_PRIORITY_LANES 8
+#define QUEUE_STATS_BUCKETS 32
+#define QUEUE_STATS_SOJOURN_SAMPLE_INTERVAL 64
+
+// Struct defs
+typedef struct ConcurrentQueue ConcurrentQueue;
+
+typedef enum {
+    QUEUE_MODE_MUTEX,
+    QUEUE_MODE_LOCK_FREE,
+    QUEUE_MODE_RING,
+    QUEUE_MODE_TWO_LOCK,
+    QUEUE_MODE_SEGMENTED,
+    QUEUE_MODE_SPSC,
+    QUEUE_MODE_FLAT_COMBINING,
+} QueueMode;
+
+typedef enum {
+    QUEUE_FULL_BLOCK,
+    QUEUE_FULL_FAIL,
+    QUEUE_FULL_SPIN,
+} QueueFullPolicy;
+
+typedef enum {
+    QUEUE_WAIT_CONDVAR,
+    QUEUE_WAIT_SPIN_FUTEX,
+} QueueWaitMode;
+
+typedef struct {
+    QueueMode mode;
+    size_t element_size;
+    size_t pool_prewarm;
+    size_t pool_max_retained;
+    size_t ring_capacity;
+    size_t segment_capacity;
+    QueueFullPolicy full_policy;
+    QueueWaitMode wait_mode;
+    unsigned int spin_budget;
+    unsigned int priority_lanes;
+    unsigned int priority_aging;
+    bool enable_stats;
+    bool enable_fd;
+} QueueConfig;
+
+typedef struct {
+    size_t enqueued;
+    size_t dequeued;
+    size_t try_hits;
+    size_t try_misses;
+    size_t depth;
+    size_t high_water_mark;
+    size_t parked_threads;
+    size_t lock_wait_histogram[QUEUE_STATS_BUCKETS];
+    size_t sojourn_histogram[QUEUE_STATS_BUCKETS];
+} QueueStatsSnapshot;
+
+/*Handle based interface*/
+
+/**
+ * @brief Fills a QueueConfig with the default settings used by queueCreate.
+ *
+ * @param config The configuration to fill.
+ */
+void queueDefaultConfig(QueueConfig *config);
+
+/**
+ * @brief Allocates and initializes a new, independent queue instance with the default configuration.
+ *
+ * @return A pointer to the new queue or NULL if memory allocation failed.
+ */
+ConcurrentQueue* queueCreate(void);
+
+/**
+ * @brief Allocates and initializes a new, independent queue instance.
+ *
+ * @param config The configuration of the queue. mode selects the implementation and element_size the size
+ * in bytes of the values the queue copies into its own storage, 0 for a queue of void* items. pool_prewarm nodes are
+ * allocated up front and at most pool_max_retained free nodes are kept by the queue instead of being
+ * returned to the heap. Bounded modes hold ring_capacity items (rounded up to a power of two) and treat
+ * an enqueue into a full queue according to full_policy. QUEUE_MODE_SEGMENTED stores segment_capacity items
+ * per segment and counts pool_prewarm and pool_max_retained in items. In QUEUE_MODE_MUTEX, wait_mode selects how a blocked
+ * dequeue waits, QUEUE_WAIT_SPIN_FUTEX spins for up to spin_budget pauses before sleeping on a futex.
+ * QUEUE_MODE_FLAT_COMBINING always spins for up to spin_budget pauses before sleeping.
+ * QUEUE_MODE_MUTEX keeps priority_lanes FIFO lanes (at most QUEUE_MAX_PRIORITY_LANES) and dequeues from the
+ * most urgent non-empty one, unless a less urgent lane went priority_aging dequeues without being served,
+ * 0 disables aging. The other modes ignore the priority of an enqueue.
+ * enable_stats turns on the counters read by queueStats and enable_fd creates the eventfd returned by
+ * queueGetFd.
+ *
+ * @return A pointer to the new queue or NULL if memory allocation failed.
+ */
+ConcurrentQueue* queueCreateWithConfig(const QueueConfig *config);
+
+/**
+ * @brief Destroys a queue created by queueCreate and frees all of its resources.
+ *
+ * @param queue The queue to destroy.
+ */
+void queueDestroy(ConcurrentQueue *queue);
+
+/**
+ * @brief Enqueues an item into the queue and wakes up a waiting thread if one exists.
+ *
+ * @param queue The queue to enqueue into.
+ * @param item The item to enqueue.
+ *
+ * @return True if the item was enqueued, false if memory allocation failed or a bounded queue using
+ * QUEUE_FULL_FAIL was full.
+ */
+bool queueEnqueue(ConcurrentQueue *queue, void *item);
+
+/**
+ * @brief Dequeues an item from the queue, blocking while the queue is empty.
+ *
+ * @param queue The queue to dequeue from.
+ *
+ * @return The dequeued item.
+ */
+void* queueDequeue(ConcurrentQueue *queue);
+
+/**
+ * @brief Tries to dequeue an item from the queue without blocking.
+ *
+ * @param queue The queue to dequeue from.
+ * @param item A pointer to the location in which to save the dequeued item.
+ *
+ * @return True if an item was dequeued, otherwise false.
+ */
+bool queueTryDequeue(ConcurrentQueue *queue, void **item);
+
+/**
+ * @brief Enqueues several items, taking the queue's lock once for the whole batch in QUEUE_MODE_MUTEX.
+ *
+ * @param queue The queue to enqueue into.
+ * @param items The items to enqueue, in FIFO order.
+ * @param amount The amount of items.
+ *
+ * @return The amount of items enqueued, a prefix of items. Less than amount only if memory allocation
+ * failed or a bounded queue using QUEUE_FULL_FAIL filled up.
+ */
+size_t queueEnqueueBatch(ConcurrentQueue *queue, void* const *items, size_t amount);
+
+/**
+ * @brief Dequeues up to max_items items once at least min_items are available or the deadline passed.
+ *
+ * @param queue The queue to dequeue from.
+ * @param items The array in which to save the dequeued items, of at least max_items entries.
+ * @param max_items The maximal amount of items to dequeue.
+ * @param min_items The amount of items to wait for, 0 never blocks.
+ * @param deadline An absolute TIME_UTC deadline after which whatever is available is taken, NULL to wait
+ * for min_items without a deadline.
+ *
+ * @return The amount of items dequeued.
+ */
+size_t queueDequeueBatch(ConcurrentQueue *queue, void **items, size_t max_items, size_t min_items,
+                         const struct timespec *deadline);
+
+/**
+ * @brief Returns the size in bytes of the values held by the queue, sizeof(void*) for a queue of items.
+ *
+ * @param queue The queue to query.
+ */
+size_t queueElementSize(ConcurrentQueue *queue);
+
+/**
+ * @brief Copies a value into the queue's own storage and wakes up a waiting thread if one exists.
+ *
+ * The pointer based functions above are the same operations on a queue whose values are void* items.
+ *
+ * @param queue The queue to enqueue into.
+ * @param value The value to copy, queueElementSize bytes.
+ *
+ * @return True if the value was enqueued, false if memory allocation failed or a bounded queue using
+ * QUEUE_FULL_FAIL was full.
+ */
+bool queueEnqueueValue(ConcurrentQueue *queue, const void *value);
+
+/**
+ * @brief Enqueues an item into the priority lane of the queue, as queueEnqueue.
+ *
+ * @param queue The queue to enqueue into.
+ * @param item The item to enqueue.
+ * @param priority The lane of the item, higher is more urgent. queueEnqueue uses priority 0 and priorities
+ * above the queue's last lane are clamped to it.
+ *
+ * @return True if the item was enqueued, false if memory allocation failed or a bounded queue using
+ * QUEUE_FULL_FAIL was full.
+ */
+bool queueEnqueuePriority(ConcurrentQueue *queue, void *item, unsigned int priority);
+
+/**
+ * @brief Copies a value into the priority lane of the queue, as queueEnqueueValue.
+ *
+ * @param queue The queue to enqueue into.
+ * @param value The value to copy, queueElementSize bytes.
+ * @param priority The lane of the value, higher is more urgent.
+ *
+ * @return True if the value was enqueued, false if memory allocation failed or a bounded queue using
+ * QUEUE_FULL_FAIL was full.
+ */
+bool queueEnqueueValuePriority(ConcurrentQueue *queue, const void *value, unsigned int priority);
+
+/**
+ * @brief Copies the head value out of the queue, blocking while the queue is empty.
+ *
+ * @param queue The queue to dequeue from.
+ * @param value The location in which to save the value, queueElementSize bytes.
+ */
+void queueDequeueValue(ConcurrentQueue *queue, void *value);
+
+/**
+ * @brief Tries to copy the head value out of the queue without blocking.
+ *
+ * @param queue The queue to dequeue from.
+ * @param value The location in which to save the value, queueElementSize bytes. Left untouched if the
+ * queue was empty.
+ *
+ * @return True if a value was dequeued, otherwise false.
+ */
+bool queueTryDequeueValue(ConcurrentQueue *queue, void *value);
+
+/**
+ * @brief Copies several values into the queue, as queueEnqueueBatch.
+ *
+ * @param queue The queue to enqueue into.
+ * @param values The values to enqueue in FIFO order, amount values of queueElementSize bytes each.
+ * @param amount The amount of values.
+ *
+ * @return The amount of values enqueued, a prefix of values.
+ */
+size_t queueEnqueueValueBatch(ConcurrentQueue *queue, const void *values, size_t amount);
+
+/**
+ * @brief Copies up to max_values values out of the queue, as queueDequeueBatch.
+ *
+ * @param queue The queue to dequeue from.
+ * @param values The array in which to save the values, of at least max_values values of queueElementSize bytes.
+ * @param max_values The maximal amount of values to dequeue.
+ * @param min_values The amount of values to wait for, 0 never blocks.
+ * @param deadline An absolute TIME_UTC deadline after which whatever is available is taken, NULL to wait
+ * for min_values without a deadline.
+ *
+ * @return The amount of values dequeued.
+ */
+size_t queueDequeueValueBatch(ConcurrentQueue *queue, void *values, size_t max_values, size_t min_values,
+                              const struct timespec *deadline);
+
+/**
+ * @brief Returns the amount of items that were enqueued and then dequeued from the queue.
+ *
+ * @param queue The queue to query.
+ */
+size_t queueVisited(ConcurrentQueue *queue);
+
+/**
+ * @brief Takes a snapshot of the queue's statistics without stopping other threads.
+ *
+ * Counters are kept in per thread shards and summed here, so the snapshot is not taken at a single point
+ * in time. Histogram bucket 0 counts zero nanoseconds and bucket i counts values in [2^(i-1), 2^i)
+ * nanoseconds, the last bucket also counts everything above. Lock waits are only measured in the lock
+ * based modes, sojourn times are sampled once every QUEUE_STATS_SOJOURN_SAMPLE_INTERVAL enqueues of
+ * a thread.
+ *
+ * @param queue The queue to query.
+ * @param snapshot A pointer to the location in which to save the statistics.
+ *
+ * @return True on success, false if the queue was created without enable_stats.
+ */
+bool queueStats(ConcurrentQueue *queue, QueueStatsSnapshot *snapshot);
+
+/**
+ * @brief Returns an eventfd that becomes readable once items were enqueued, for use with poll or epoll.
+ *
+ * A burst of enqueues makes the descriptor readable once. A consumer woken up by it calls queueAckFd and
+ * then drains the queue with queueTryDequeue or queueDequeueBatch until it is empty, any item enqueued
+ * after the acknowledgement makes the descriptor readable again. The descriptor belongs to the queue and
+ * is closed by queueDestroy.
+ *
+ * @param queue The queue to query.
+ *
+ * @return The file descriptor, or -1 if the queue was created without enable_fd.
+ */
+int queueGetFd(ConcurrentQueue *queue);
+
+/**
+ * @brief Makes the descriptor returned by queueGetFd unreadable until the next enqueue. Must be called
+ * before draining the queue, never after.
+ *
+ * @param queue The queue whose descriptor to acknowledge, created with enable_fd.
+ *
+ * @return True if the descriptor was readable, false otherwise.
+ */
+bool queueAckFd(ConcurrentQueue *queue);
+
+/*Tracing interface*/
+
+/**
+ * @brief Starts recording the enqueues, dequeues, parks, wakes and lock acquisitions of every queue into
+ * per thread trace buffers, each holding the thread's latest QUEUE_TRACE_BUFFER_EVENTS events.
+ *
+ * Tracing is only compiled in with -DQUEUE_TRACE (make TRACE=1). Compiled in but stopped, every traced
+ * operation pays a single branch on a flag that is not written.
+ *
+ * @return True if tracing started, false if it was not compiled in.
+ */
+bool queueTraceStart(void);
+
+/**
+ * @brief Stops recording events, keeping the recorded ones for the dumps.
+ */
+void queueTraceStop(void);
+
+/**
+ * @brief Writes the events recorded since the last queueTraceStart as a Chrome trace event JSON file, for
+ * chrome://tracing or Perfetto. May be called while tracing.
+ *
+ * @param path The file to write.
+ *
+ * @return True on success, false if tracing is not compiled in or the file could not be written.
+ */
+bool queueTraceDumpChrome(const char *path);
+
+/**
+ * @brief Writes the events recorded since the last queueTraceStart in the compact binary trace format
+ * described in queue_trace.c. May be called while tracing.
+ *
+ * @param path The file to write.
+ *
+ * @return True on success, false if tracing is not compiled in or the file could not be written.
+ */
+bool queueTraceDumpBinary(const char *path);
+
+/*Default instance interface*/
+
+void initQueue(void);
+void enqueue(void*);
+void* dequeue(void);
+bool tryDequeue(void**);
+size_t visited(void);
+void destroyQueue(void);
+
+#endif
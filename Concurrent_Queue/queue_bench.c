@@ -0,0 +1,631 @@
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+#include "queue.h"
+#include "queue_internal.h"
+
+// Constants
+#define MAX_SWEEP_VALUES 16
+#define MAX_BATCH 1024
+#define LATENCY_SUB_BUCKET_BITS 4
+#define LATENCY_BUCKETS (64 << LATENCY_SUB_BUCKET_BITS)
+#define DEFAULT_ITEMS_PER_PRODUCER 200000
+
+// Struct defs
+typedef struct {
+    const char *name;
+    QueueMode mode;
+    bool single_pair;
+} BenchMode;
+
+typedef struct {
+    size_t values[MAX_SWEEP_VALUES];
+    size_t amount;
+} SweepList;
+
+typedef struct {
+    QueueMode mode;
+    const char *mode_name;
+    size_t producers;
+    size_t consumers;
+    size_t batch;
+    size_t try_percent;
+    size_t rate;
+    size_t items_per_producer;
+} BenchCase;
+
+typedef struct {
+    ConcurrentQueue *queue;
+    const BenchCase *bench_case;
+    atomic_bool *start;
+    atomic_size_t *unclaimed_items;
+    uint32_t random_state;
+    size_t latency_histogram[LATENCY_BUCKETS];
+} BenchThread;
+
+typedef struct {
+    double seconds;
+    double throughput;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    double allocations_per_item;
+} BenchResult;
+
+
+// Function declaration
+void* __real_malloc(size_t);
+void* __real_aligned_alloc(size_t, size_t);
+void* __wrap_malloc(size_t);
+void* __wrap_aligned_alloc(size_t, size_t);
+static bool parse_list(const char*, SweepList*);
+static bool parse_modes(const char*, SweepList*);
+static void run_case(const BenchCase*, BenchResult*);
+static int producer_main(void*);
+static int consumer_main(void*);
+static size_t claim_items(atomic_size_t*, size_t);
+static void wait_for_start(atomic_bool*);
+static void pace(uint64_t);
+static void record_latency(BenchThread*, uint64_t);
+static int latency_bucket(uint64_t);
+static uint64_t bucket_value(int);
+static uint64_t percentile(const size_t*, size_t, double);
+static uint64_t now_ns(void);
+static void print_result(const BenchCase*, const BenchResult*, bool);
+static void print_usage(const char*);
+
+
+// Global variables declarations
+static const BenchMode bench_modes[] = {
+    {"mutex", QUEUE_MODE_MUTEX, false},
+    {"lock_free", QUEUE_MODE_LOCK_FREE, false},
+    {"ring", QUEUE_MODE_RING, false},
+    {"two_lock", QUEUE_MODE_TWO_LOCK, false},
+    {"segmented", QUEUE_MODE_SEGMENTED, false},
+    {"spsc", QUEUE_MODE_SPSC, true},
+    {"flat_combining", QUEUE_MODE_FLAT_COMBINING, false},
+};
+static atomic_size_t allocations;
+
+/*Interface methods*/
+
+/**
+ * @brief Sweeps every combination of the requested settings and prints one result line per combination.
+ *
+ * Every list option takes comma separated values:
+ *  --modes      Queue modes to compare, all of them by default. Single pair modes only run with one
+ *               producer and one consumer.
+ *  --producers  Producer thread counts, default 1,2,4.
+ *  --consumers  Consumer thread counts, default 1,2,4.
+ *  --batch      Items per enqueue and dequeue call, 1 uses the single item calls. Default 1.
+ *  --try        Percent of dequeues done with tryDequeue instead of a blocking dequeue. Default 0.
+ *  --rate       Items per second per producer, 0 for as fast as possible. Default 0.
+ * --items sets the amount of items per producer and --format selects csv (default) or json lines.
+ *
+ * @return 0 on success, 1 on invalid arguments.
+ *
+ */
+int main(int argc, char **argv) {
+    // Variable declaration
+    SweepList modes = {{0}, 0};
+    SweepList producers = {{1, 2, 4}, 3};
+    SweepList consumers = {{1, 2, 4}, 3};
+    SweepList batches = {{1}, 1};
+    SweepList try_percents = {{0}, 1};
+    SweepList rates = {{0}, 1};
+    size_t items_per_producer = DEFAULT_ITEMS_PER_PRODUCER;
+    bool json = false;
+    BenchCase bench_case;
+    BenchResult result;
+    size_t m, p, c, b, t, r;
+    bool valid = true;
+    int i;
+
+    for (m = 0; m < sizeof(bench_modes) / sizeof(bench_modes[0]); m++) {
+        modes.values[modes.amount++] = m;
+    }
+
+    for (i = 1; i + 1 < argc && valid; i += 2) {
+        if (strcmp(argv[i], "--modes") == 0) {
+            valid = parse_modes(argv[i + 1], &modes);
+        }
+        else if (strcmp(argv[i], "--producers") == 0) {
+            valid = parse_list(argv[i + 1], &producers);
+        }
+        else if (strcmp(argv[i], "--consumers") == 0) {
+            valid = parse_list(argv[i + 1], &consumers);
+        }
+        else if (strcmp(argv[i], "--batch") == 0) {
+            valid = parse_list(argv[i + 1], &batches);
+        }
+        else if (strcmp(argv[i], "--try") == 0) {
+            valid = parse_list(argv[i + 1], &try_percents);
+        }
+        else if (strcmp(argv[i], "--rate") == 0) {
+            valid = parse_list(argv[i + 1], &rates);
+        }
+        else if (strcmp(argv[i], "--items") == 0) {
+            items_per_producer = strtoull(argv[i + 1], NULL, 10);
+            valid = items_per_producer > 0;
+        }
+        else if (strcmp(argv[i], "--format") == 0) {
+            json = strcmp(argv[i + 1], "json") == 0;
+            valid = json || strcmp(argv[i + 1], "csv") == 0;
+        }
+        else {
+            valid = false;
+        }
+    }
+    if (!valid || i != argc) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (!json) {
+        printf("mode,producers,consumers,batch,try_percent,rate,items,seconds,throughput,"
+               "p50_ns,p99_ns,p999_ns,allocations_per_item\n");
+    }
+    for (m = 0; m < modes.amount; m++)
+    for (p = 0; p < producers.amount; p++)
+    for (c = 0; c < consumers.amount; c++)
+    for (b = 0; b < batches.amount; b++)
+    for (t = 0; t < try_percents.amount; t++)
+    for (r = 0; r < rates.amount; r++) {
+        if (bench_modes[modes.values[m]].single_pair && (producers.values[p] != 1 || consumers.values[c] != 1)) {
+            continue;
+        }
+        bench_case.mode = bench_modes[modes.values[m]].mode;
+        bench_case.mode_name = bench_modes[modes.values[m]].name;
+        bench_case.producers = producers.values[p];
+        bench_case.consumers = consumers.values[c];
+        bench_case.batch = batches.values[b];
+        bench_case.try_percent = try_percents.values[t];
+        bench_case.rate = rates.values[r];
+        bench_case.items_per_producer = items_per_producer;
+        run_case(&bench_case, &result);
+        print_result(&bench_case, &result, json);
+        fflush(stdout);
+    }
+    return 0;
+}
+
+/**
+ * @brief Counts every malloc made by the library and the benchmark, linked with -Wl,--wrap=malloc.
+ *
+ */
+void* __wrap_malloc(size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+/**
+ * @brief Counts every aligned_alloc made by the library and the benchmark, linked with -Wl,--wrap=aligned_alloc.
+ *
+ */
+void* __wrap_aligned_alloc(size_t alignment, size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_aligned_alloc(alignment, size);
+}
+
+/*Private methods*/
+
+/**
+ * @brief Parses a comma separated list of positive integers, 0 allowed.
+ *
+ * @return True on success, false if a value is not a number or there are too many values.
+ *
+ * @note Used by main.
+ *
+ */
+static bool parse_list(const char *text, SweepList *list) {
+    // Variable declaration
+    char *end;
+
+    list->amount = 0;
+    while (*text != '\0') {
+        if (list->amount == MAX_SWEEP_VALUES) {
+            return false;
+        }
+        list->values[list->amount++] = strtoull(text, &end, 10);
+        if (end == text || (*end != ',' && *end != '\0')) {
+            return false;
+        }
+        text = *end == ',' ? end + 1 : end;
+    }
+    return list->amount > 0;
+}
+
+/**
+ * @brief Parses a comma separated list of mode names into indices of bench_modes.
+ *
+ * @return True on success, false if a name is unknown.
+ *
+ * @note Used by main.
+ *
+ */
+static bool parse_modes(const char *text, SweepList *list) {
+    // Variable declaration
+    size_t length;
+    size_t m;
+    bool found;
+
+    list->amount = 0;
+    while (*text != '\0') {
+        length = strcspn(text, ",");
+        found = false;
+        for (m = 0; m < sizeof(bench_modes) / sizeof(bench_modes[0]) && !found; m++) {
+            if (strlen(bench_modes[m].name) == length && strncmp(bench_modes[m].name, text, length) == 0) {
+                found = list->amount < MAX_SWEEP_VALUES;
+                if (found) {
+                    list->values[list->amount++] = m;
+                }
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        text += text[length] == ',' ? length + 1 : length;
+    }
+    return list->amount > 0;
+}
+
+/**
+ * @brief Runs one combination of settings and measures it.
+ *
+ * All threads are created first and spin on a start flag, so thread creation is outside the measured
+ * window. Consumers claim the items they will dequeue from a shared counter, which lets every blocking
+ * dequeue be satisfied and the run end without sentinel items. Each item carries its enqueue timestamp
+ * as its value, the consumer turns it into a handoff latency.
+ *
+ * @param bench_case The settings to run.
+ * @param result A pointer to the location in which to save the measurements.
+ *
+ * @note Used by main.
+ *
+ */
+static void run_case(const BenchCase *bench_case, BenchResult *result) {
+    // Variable declaration
+    QueueConfig config;
+    ConcurrentQueue *queue;
+    BenchThread *threads;
+    thrd_t *thread_ids;
+    size_t thread_amount = bench_case->producers + bench_case->consumers;
+    size_t total_items = bench_case->producers * bench_case->items_per_producer;
+    size_t *merged_histogram;
+    atomic_bool start;
+    atomic_size_t unclaimed_items;
+    size_t allocations_before;
+    uint64_t start_time;
+    size_t i;
+    int j;
+
+    queueDefaultConfig(&config);
+    config.mode = bench_case->mode;
+    queue = queueCreateWithConfig(&config);
+    threads = calloc(thread_amount, sizeof(BenchThread));
+    thread_ids = malloc(thread_amount * sizeof(thrd_t));
+    merged_histogram = calloc(LATENCY_BUCKETS, sizeof(size_t));
+    if (queue == NULL || threads == NULL || thread_ids == NULL || merged_histogram == NULL) {
+        fprintf(stderr, "queue_bench: out of memory\n");
+        exit(1);
+    }
+
+    atomic_init(&start, false);
+    atomic_init(&unclaimed_items, total_items);
+    for (i = 0; i < thread_amount; i++) {
+        threads[i].queue = queue;
+        threads[i].bench_case = bench_case;
+        threads[i].start = &start;
+        threads[i].unclaimed_items = &unclaimed_items;
+        threads[i].random_state = (uint32_t)(i + 1) * 2654435761u;
+        thrd_create(&thread_ids[i], i < bench_case->producers ? producer_main : consumer_main, &threads[i]);
+    }
+
+    allocations_before = atomic_load(&allocations);
+    start_time = now_ns();
+    atomic_store(&start, true);
+    for (i = 0; i < thread_amount; i++) {
+        thrd_join(thread_ids[i], NULL);
+    }
+    result->seconds = (double)(now_ns() - start_time) / 1e9;
+    result->allocations_per_item = (double)(atomic_load(&allocations) - allocations_before) / (double)total_items;
+    result->throughput = (double)total_items / result->seconds;
+
+    for (i = bench_case->producers; i < thread_amount; i++) {
+        for (j = 0; j < LATENCY_BUCKETS; j++) {
+            merged_histogram[j] += threads[i].latency_histogram[j];
+        }
+    }
+    result->p50_ns = percentile(merged_histogram, total_items, 0.5);
+    result->p99_ns = percentile(merged_histogram, total_items, 0.99);
+    result->p999_ns = percentile(merged_histogram, total_items, 0.999);
+
+    queueDestroy(queue);
+    free(merged_histogram);
+    free(thread_ids);
+    free(threads);
+}
+
+/**
+ * @brief Enqueues the producer's items, in batches if requested, stamping each with the current time.
+ *
+ * @note Used by run_case as a thread start routine.
+ *
+ */
+static int producer_main(void *context) {
+    // Variable declaration
+    BenchThread *thread = context;
+    const BenchCase *bench_case = thread->bench_case;
+    void *items[MAX_BATCH];
+    size_t batch = bench_case->batch == 0 ? 1 : bench_case->batch > MAX_BATCH ? MAX_BATCH : bench_case->batch;
+    size_t produced = 0;
+    size_t amount;
+    size_t enqueued;
+    uint64_t interval = bench_case->rate == 0 ? 0 : 1000000000u / bench_case->rate;
+    uint64_t next_time;
+    uint64_t timestamp;
+    size_t i;
+
+    wait_for_start(thread->start);
+    next_time = now_ns();
+    while (produced < bench_case->items_per_producer) {
+        amount = bench_case->items_per_producer - produced < batch ? bench_case->items_per_producer - produced : batch;
+        if (interval != 0) {
+            pace(next_time);
+            next_time += interval * amount;
+        }
+
+        timestamp = now_ns();
+        if (amount == 1 && bench_case->batch <= 1) {
+            while (!queueEnqueue(thread->queue, (void*)(uintptr_t)timestamp)) {
+                thrd_yield();
+            }
+        }
+        else {
+            for (i = 0; i < amount; i++) {
+                items[i] = (void*)(uintptr_t)timestamp;
+            }
+            for (enqueued = 0; enqueued < amount; ) {
+                enqueued += queueEnqueueBatch(thread->queue, items + enqueued, amount - enqueued);
+            }
+        }
+        produced += amount;
+    }
+    return 0;
+}
+
+/**
+ * @brief Dequeues claimed items until none are left, mixing tryDequeue and blocking calls as requested.
+ *
+ * @note Used by run_case as a thread start routine.
+ *
+ */
+static int consumer_main(void *context) {
+    // Variable declaration
+    BenchThread *thread = context;
+    const BenchCase *bench_case = thread->bench_case;
+    void *items[MAX_BATCH];
+    size_t batch = bench_case->batch == 0 ? 1 : bench_case->batch > MAX_BATCH ? MAX_BATCH : bench_case->batch;
+    size_t claimed;
+    size_t dequeued;
+    void *item;
+    size_t i;
+
+    wait_for_start(thread->start);
+    while ((claimed = claim_items(thread->unclaimed_items, batch)) > 0) {
+        if (bench_case->batch > 1) {
+            for (dequeued = 0; dequeued < claimed; ) {
+                dequeued += queueDequeueBatch(thread->queue, items + dequeued, claimed - dequeued,
+                                              claimed - dequeued, NULL);
+            }
+            for (i = 0; i < claimed; i++) {
+                record_latency(thread, (uint64_t)(uintptr_t)items[i]);
+            }
+            continue;
+        }
+
+        thread->random_state ^= thread->random_state << 13;
+        thread->random_state ^= thread->random_state >> 17;
+        thread->random_state ^= thread->random_state << 5;
+        if (thread->random_state % 100 < bench_case->try_percent) {
+            while (!queueTryDequeue(thread->queue, &item)) {
+                queue_cpu_relax();
+            }
+        }
+        else {
+            item = queueDequeue(thread->queue);
+        }
+        record_latency(thread, (uint64_t)(uintptr_t)item);
+    }
+    return 0;
+}
+
+/**
+ * @brief Claims up to wanted items from the shared counter of items no consumer claimed yet.
+ *
+ * @return The amount of items claimed, 0 once every item was claimed.
+ *
+ * @note Used by consumer_main.
+ *
+ */
+static size_t claim_items(atomic_size_t *unclaimed_items, size_t wanted) {
+    // Variable declaration
+    size_t unclaimed;
+    size_t claimed;
+
+    unclaimed = atomic_load(unclaimed_items);
+    do {
+        if (unclaimed == 0) {
+            return 0;
+        }
+        claimed = unclaimed < wanted ? unclaimed : wanted;
+    } while (!atomic_compare_exchange_weak(unclaimed_items, &unclaimed, unclaimed - claimed));
+    return claimed;
+}
+
+/**
+ * @brief Spins until the main thread starts the measured window.
+ *
+ * @note Used by producer_main and consumer_main.
+ *
+ */
+static void wait_for_start(atomic_bool *start) {
+    while (!atomic_load_explicit(start, memory_order_acquire)) {
+        thrd_yield();
+    }
+}
+
+/**
+ * @brief Waits until the given time, sleeping while it is far away and spinning for the last stretch.
+ *
+ * @note Used by producer_main.
+ *
+ */
+static void pace(uint64_t target_time) {
+    // Variable declaration
+    struct timespec nap = {0, 50000};
+
+    while (target_time > now_ns() + 100000) {
+        thrd_sleep(&nap, NULL);
+    }
+    while (target_time > now_ns()) {
+        queue_cpu_relax();
+    }
+}
+
+/**
+ * @brief Adds the latency of an item stamped at enqueue_time to the consumer's histogram.
+ *
+ * @note Used by consumer_main.
+ *
+ */
+static void record_latency(BenchThread *thread, uint64_t enqueue_time) {
+    // Variable declaration
+    uint64_t now = now_ns();
+
+    thread->latency_histogram[latency_bucket(now > enqueue_time ? now - enqueue_time : 0)]++;
+}
+
+/**
+ * @brief Maps a latency to a log linear bucket, 2^LATENCY_SUB_BUCKET_BITS buckets per power of two.
+ *
+ * This bounds the relative error of a reported percentile by about 6% while the histogram stays small
+ * enough to be kept per thread.
+ *
+ * @note Used by record_latency.
+ *
+ */
+static int latency_bucket(uint64_t latency_ns) {
+    // Variable declaration
+    int magnitude;
+
+    if (latency_ns < (1u << LATENCY_SUB_BUCKET_BITS)) {
+        return (int)latency_ns;
+    }
+    magnitude = 63 - __builtin_clzll(latency_ns);
+    return ((magnitude - LATENCY_SUB_BUCKET_BITS + 1) << LATENCY_SUB_BUCKET_BITS) +
+           (int)((latency_ns >> (magnitude - LATENCY_SUB_BUCKET_BITS)) & ((1u << LATENCY_SUB_BUCKET_BITS) - 1));
+}
+
+/**
+ * @brief Returns the lowest latency mapped to a bucket.
+ *
+ * @note Used by percentile.
+ *
+ */
+static uint64_t bucket_value(int bucket) {
+    // Variable declaration
+    int magnitude;
+    uint64_t sub_bucket;
+
+    if (bucket < (1 << LATENCY_SUB_BUCKET_BITS)) {
+        return (uint64_t)bucket;
+    }
+    magnitude = (bucket >> LATENCY_SUB_BUCKET_BITS) + LATENCY_SUB_BUCKET_BITS - 1;
+    sub_bucket = (uint64_t)(bucket & ((1 << LATENCY_SUB_BUCKET_BITS) - 1));
+    return (((uint64_t)1 << LATENCY_SUB_BUCKET_BITS) | sub_bucket) << (magnitude - LATENCY_SUB_BUCKET_BITS);
+}
+
+/**
+ * @brief Returns the latency below which the given fraction of the recorded latencies falls.
+ *
+ * @note Used by run_case.
+ *
+ */
+static uint64_t percentile(const size_t *histogram, size_t total, double fraction) {
+    // Variable declaration
+    size_t rank = (size_t)((double)total * fraction);
+    size_t seen = 0;
+    int bucket;
+
+    for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += histogram[bucket];
+        if (seen > rank) {
+            return bucket_value(bucket);
+        }
+    }
+    return bucket_value(LATENCY_BUCKETS - 1);
+}
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ *
+ * @note Used throughout the benchmark.
+ *
+ */
+static uint64_t now_ns(void) {
+    // Variable declaration
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Prints the result of one combination as a CSV row or a JSON object on its own line.
+ *
+ * @note Used by main.
+ *
+ */
+static void print_result(const BenchCase *bench_case, const BenchResult *result, bool json) {
+    if (json) {
+        printf("{\"mode\":\"%s\",\"producers\":%zu,\"consumers\":%zu,\"batch\":%zu,\"try_percent\":%zu,"
+               "\"rate\":%zu,\"items\":%zu,\"seconds\":%.6f,\"throughput\":%.0f,\"p50_ns\":%llu,"
+               "\"p99_ns\":%llu,\"p999_ns\":%llu,\"allocations_per_item\":%.4f}\n",
+               bench_case->mode_name, bench_case->producers, bench_case->consumers, bench_case->batch,
+               bench_case->try_percent, bench_case->rate, bench_case->producers * bench_case->items_per_producer,
+               result->seconds, result->throughput, (unsigned long long)result->p50_ns,
+               (unsigned long long)result->p99_ns, (unsigned long long)result->p999_ns,
+               result->allocations_per_item);
+        return;
+    }
+    printf("%s,%zu,%zu,%zu,%zu,%zu,%zu,%.6f,%.0f,%llu,%llu,%llu,%.4f\n",
+           bench_case->mode_name, bench_case->producers, bench_case->consumers, bench_case->batch,
+           bench_case->try_percent, bench_case->rate, bench_case->producers * bench_case->items_per_producer,
+           result->seconds, result->throughput, (unsigned long long)result->p50_ns,
+           (unsigned long long)result->p99_ns, (unsigned long long)result->p999_ns, result->allocations_per_item);
+}
+
+/**
+ * @brief Prints the supported options.
+ *
+ * @note Used by main.
+ *
+ */
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [--modes mutex,lock_free,ring] [--producers 1,2,4] [--consumers 1,2,4] [--batch 1]\n"
+            "          [--try 0] [--rate 0] [--items %d] [--format csv|json]\n",
+            program, DEFAULT_ITEMS_PER_PRODUCER);
+}
+
+/* Used sources
+    1. Linker symbol wrapping: https://sourceware.org/binutils/docs/ld/Options.html
+    2. Monotonic clock: https://man7.org/linux/man-pages/man3/clock_gettime.3.html
+*/
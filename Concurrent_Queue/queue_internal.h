@@ -0,0 +1,127 @@
+#ifndef QUEUE_INTERNAL_H
+#define QUEUE_INTERNAL_H
+
+// Includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include "queue.h"
+
+// Constants
+#define QUEUE_CACHE_LINE 64
+#define QUEUE_SPIN_YIELD_INTERVAL 64
+#define QUEUE_BATCH_POLL_INTERVAL_NS 50000
+
+// Struct defs
+/**
+ * Operations a queue mode implements. Values are copied in and out of the queue's storage, element_size
+ * bytes each, and batches are contiguous arrays of values. The batch operations are optional, queue.c falls
+ * back to looping over the single value operations when a mode leaves them NULL. enqueue_priority is
+ * optional as well, modes without priority lanes leave it NULL and get a plain enqueue.
+ */
+typedef struct {
+    bool (*enqueue)(ConcurrentQueue*, const void*);
+    void (*dequeue)(ConcurrentQueue*, void*);
+    bool (*enqueue_priority)(ConcurrentQueue*, const void*, unsigned int);
+    bool (*try_dequeue)(ConcurrentQueue*, void*);
+    size_t (*enqueue_batch)(ConcurrentQueue*, const void*, size_t);
+    size_t (*dequeue_batch)(ConcurrentQueue*, void*, size_t, size_t, const struct timespec*);
+    size_t (*visited)(ConcurrentQueue*);
+    void (*destroy)(ConcurrentQueue*);
+} QueueOps;
+
+/**
+ * Common header of every queue mode. Each mode embeds it as the first member of its own struct, so a
+ * ConcurrentQueue pointer can be cast to the mode specific struct by the mode's operations. element_size,
+ * stats and notifier are set by queueCreateWithConfig after the mode created the queue, stats and notifier
+ * are NULL while statistics or the eventfd are disabled.
+ */
+struct ConcurrentQueue {
+    const QueueOps *ops;
+    size_t element_size;
+    struct QueueStats *stats;
+    struct QueueNotifier *notifier;
+};
+
+/**
+ * @brief Hints the CPU that the calling thread is spinning on a shared location.
+ */
+static inline void queue_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * @brief Copies one value of a queue. Pointer sized values, the values of every void* queue, are copied
+ * with a single fixed size move instead of a call into memcpy.
+ */
+static inline void queue_copy_value(void *destination, const void *source, size_t element_size) {
+    if (element_size == sizeof(void*)) {
+        memcpy(destination, source, sizeof(void*));
+    }
+    else {
+        memcpy(destination, source, element_size);
+    }
+}
+
+/**
+ * @brief Rounds a requested capacity up to a power of two of at least 2, so positions map to slots with a mask.
+ */
+static inline size_t queue_round_up_to_power_of_two(size_t requested_capacity) {
+    // Variable declaration
+    size_t capacity = 2;
+
+    while (capacity < requested_capacity) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// Mode constructors
+/**
+ * @brief Creates a queue in QUEUE_MODE_LOCK_FREE.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ */
+ConcurrentQueue* lock_free_queue_create(const QueueConfig *config);
+
+/**
+ * @brief Creates a queue in QUEUE_MODE_RING.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ */
+ConcurrentQueue* ring_queue_create(const QueueConfig *config);
+
+/**
+ * @brief Creates a queue in QUEUE_MODE_TWO_LOCK.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ */
+ConcurrentQueue* two_lock_queue_create(const QueueConfig *config);
+
+/**
+ * @brief Creates a queue in QUEUE_MODE_SEGMENTED.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ */
+ConcurrentQueue* segmented_queue_create(const QueueConfig *config);
+
+/**
+ * @brief Creates a queue in QUEUE_MODE_SPSC.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ */
+ConcurrentQueue* spsc_queue_create(const QueueConfig *config);
+
+/**
+ * @brief Creates a queue in QUEUE_MODE_FLAT_COMBINING.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ */
+ConcurrentQueue* flat_combining_queue_create(const QueueConfig *config);
+
+#endif
@@ -0,0 +1,103 @@
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "queue_notifier.h"
+
+/*Interface methods*/
+
+/**
+ * @brief Creates a notifier around a non blocking, close on exec eventfd.
+ *
+ * @return A pointer to the new notifier, or NULL if memory allocation or eventfd failed.
+ *
+ */
+QueueNotifier* queue_notifier_create(void) {
+    // Variable declaration
+    QueueNotifier *notifier;
+
+    notifier = aligned_alloc(QUEUE_CACHE_LINE, sizeof(QueueNotifier));
+    if (notifier == NULL) {
+        return NULL;
+    }
+    notifier->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notifier->event_fd < 0) {
+        free(notifier);
+        return NULL;
+    }
+    atomic_init(&notifier->signaled, false);
+    return notifier;
+}
+
+/**
+ * @brief Closes the eventfd of a notifier and frees it.
+ *
+ * @param notifier The notifier to destroy, may be NULL.
+ *
+ */
+void queue_notifier_destroy(QueueNotifier *notifier) {
+    if (notifier == NULL) {
+        return;
+    }
+    close(notifier->event_fd);
+    free(notifier);
+}
+
+/**
+ * @brief Makes the eventfd readable unless a signal is already pending.
+ *
+ * Only the enqueue that flips signaled from false writes to the eventfd, so a burst of enqueues between
+ * two acknowledgements costs a single system call and a single wake up of the consumer's event loop.
+ * Every other enqueue pays a fence and a load of a line that only changes once per burst.
+ *
+ * The fence pairs with the one in queue_notifier_ack. Either the consumer's drain after its
+ * acknowledgement sees the items published before the fence, or this signal sees the cleared flag and
+ * makes the eventfd readable again.
+ *
+ * @param notifier The notifier to signal, NULL if the queue was created without enable_fd.
+ *
+ */
+void queue_notifier_signal(QueueNotifier *notifier) {
+    // Variable declaration
+    uint64_t one = 1;
+
+    if (notifier == NULL) {
+        return;
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&notifier->signaled, memory_order_relaxed) ||
+        atomic_exchange_explicit(&notifier->signaled, true, memory_order_relaxed)) {
+        return;
+    }
+    if (write(notifier->event_fd, &one, sizeof(one)) < 0) {
+        // Leave the signal to the next enqueue
+        atomic_store_explicit(&notifier->signaled, false, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Resets the eventfd counter and clears the pending signal, so the next enqueue signals again.
+ *
+ * @param notifier The notifier to acknowledge.
+ *
+ * @return True if a signal was pending, false if the eventfd was not readable.
+ *
+ */
+bool queue_notifier_ack(QueueNotifier *notifier) {
+    // Variable declaration
+    uint64_t counter;
+    bool was_signaled;
+
+    was_signaled = read(notifier->event_fd, &counter, sizeof(counter)) == sizeof(counter);
+    atomic_store_explicit(&notifier->signaled, false, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    return was_signaled;
+}
+
+/* Used sources
+    1. eventfd: https://man7.org/linux/man-pages/man2/eventfd.2.html
+    2. Atomics: https://en.cppreference.com/w/c/atomic
+*/
@@ -0,0 +1,40 @@
+#ifndef QUEUE_NOTIFIER_H
+#define QUEUE_NOTIFIER_H
+
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "queue_internal.h"
+
+// Struct defs
+typedef struct QueueNotifier {
+    int event_fd;
+    _Alignas(QUEUE_CACHE_LINE) atomic_bool signaled;
+} QueueNotifier;
+
+/**
+ * @brief Creates a notifier around a non blocking eventfd.
+ *
+ * @return A pointer to the new notifier, or NULL if memory allocation or eventfd failed.
+ */
+QueueNotifier* queue_notifier_create(void);
+
+/**
+ * @brief Closes the eventfd of a notifier and frees it.
+ */
+void queue_notifier_destroy(QueueNotifier *notifier);
+
+/**
+ * @brief Makes the eventfd readable unless it already is. Must be called after the enqueued items were
+ * published. Does nothing if notifier is NULL.
+ */
+void queue_notifier_signal(QueueNotifier *notifier);
+
+/**
+ * @brief Makes the eventfd unreadable until the next signal. Must be called before the queue is drained.
+ *
+ * @return True if a signal was pending, false if the eventfd was not readable.
+ */
+bool queue_notifier_ack(QueueNotifier *notifier);
+
+#endif
@@ -0,0 +1,324 @@
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+#include "queue_stats.h"
+#include "queue_trace.h"
+
+// Function declaration
+static QueueStatsShard* current_shard(QueueStats*);
+static int histogram_bucket(uint64_t);
+
+
+// Global variables declarations
+static atomic_uint next_shard;
+static _Thread_local int shard_index = -1;
+static _Thread_local unsigned int sample_countdown;
+
+/*Interface methods*/
+
+/**
+ * @brief Allocates a zeroed, cache line aligned statistics block.
+ *
+ * Every shard starts on its own cache line, so threads mapped to different shards never write to the
+ * same line.
+ *
+ * @return A pointer to the new block, or NULL if memory allocation failed.
+ *
+ */
+QueueStats* queue_stats_create(void) {
+    // Variable declaration
+    QueueStats *stats;
+
+    stats = aligned_alloc(QUEUE_CACHE_LINE, sizeof(QueueStats));
+    if (stats == NULL) {
+        return NULL;
+    }
+    memset(stats, 0, sizeof(QueueStats));
+    return stats;
+}
+
+/**
+ * @brief Frees a statistics block.
+ *
+ * @param stats The block to free, may be NULL.
+ *
+ */
+void queue_stats_destroy(QueueStats *stats) {
+    free(stats);
+}
+
+/**
+ * @brief Adds amount to a counter in the calling thread's shard.
+ *
+ * A relaxed add on a line other threads rarely touch, which keeps the statistics cheap enough to be left
+ * enabled.
+ *
+ * @param stats The statistics block, NULL while statistics are disabled.
+ * @param counter The counter to add to.
+ * @param amount The amount to add.
+ *
+ */
+void queue_stats_add(QueueStats *stats, QueueStatCounter counter, size_t amount) {
+    if (stats == NULL) {
+        return;
+    }
+    atomic_fetch_add_explicit(&current_shard(stats)->counters[counter], amount, memory_order_relaxed);
+}
+
+/**
+ * @brief Raises the high water mark to depth if depth exceeds it.
+ *
+ * Once the queue reached its usual depth the mark is only read, so the shared line stays in every
+ * core's cache.
+ *
+ * @param stats The statistics block, NULL while statistics are disabled.
+ * @param depth The depth the queue was observed at.
+ *
+ */
+void queue_stats_record_depth(QueueStats *stats, size_t depth) {
+    // Variable declaration
+    size_t high_water_mark;
+
+    if (stats == NULL) {
+        return;
+    }
+    high_water_mark = atomic_load_explicit(&stats->high_water_mark, memory_order_relaxed);
+    while (depth > high_water_mark) {
+        if (atomic_compare_exchange_weak_explicit(&stats->high_water_mark, &high_water_mark, depth,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Returns the depth of the queue derived from the enqueued and dequeued totals of every shard.
+ *
+ * Reads one line per shard, so modes that can not tell their depth otherwise only call it on sampled
+ * enqueues. The totals are read at slightly different times, hence the result is clamped at 0.
+ *
+ * @param stats The statistics block to read.
+ *
+ * @return The approximate depth of the queue.
+ *
+ */
+size_t queue_stats_depth(QueueStats *stats) {
+    // Variable declaration
+    size_t enqueued = 0;
+    size_t dequeued = 0;
+    int i;
+
+    for (i = 0; i < QUEUE_STATS_SHARDS; i++) {
+        enqueued += atomic_load_explicit(&stats->shards[i].counters[STAT_ENQUEUED], memory_order_relaxed);
+        dequeued += atomic_load_explicit(&stats->shards[i].counters[STAT_DEQUEUED], memory_order_relaxed);
+    }
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+/**
+ * @brief Adds delta to the amount of threads blocked in the queue.
+ *
+ * Only called on the blocking path, where the thread is about to sleep anyway, so a single shared
+ * counter is cheap enough.
+ *
+ * @param stats The statistics block, NULL while statistics are disabled.
+ * @param delta 1 before a thread blocks, -1 after it woke up.
+ *
+ */
+void queue_stats_parked(QueueStats *stats, int delta) {
+    if (stats == NULL) {
+        return;
+    }
+    atomic_fetch_add_explicit(&stats->parked_threads, delta, memory_order_relaxed);
+}
+
+/**
+ * @brief Records a lock acquisition in the lock wait histogram of the calling thread's shard.
+ *
+ * @param stats The statistics block, NULL while statistics are disabled.
+ * @param wait_ns The time the thread waited for the lock, in nanoseconds.
+ *
+ */
+void queue_stats_record_lock_wait(QueueStats *stats, uint64_t wait_ns) {
+    if (stats == NULL) {
+        return;
+    }
+    atomic_fetch_add_explicit(&current_shard(stats)->lock_wait_histogram[histogram_bucket(wait_ns)], 1,
+                              memory_order_relaxed);
+}
+
+/**
+ * @brief Locks lock, recording the time spent waiting for it in the lock wait histogram.
+ *
+ * An uncontended acquisition is recorded as a zero wait without reading the clock, so only threads that
+ * actually wait pay for the two clock reads. While tracing, every acquisition is also recorded as a
+ * lock event.
+ *
+ * @param stats The statistics block, NULL while statistics are disabled.
+ * @param lock The lock to acquire.
+ *
+ */
+void queue_stats_lock(QueueStats *stats, mtx_t *lock) {
+    // Variable declaration
+    uint64_t wait_start;
+    uint64_t trace_start = queue_trace_begin();
+
+    if (stats == NULL) {
+        mtx_lock(lock);
+        queue_trace_end(QUEUE_TRACE_LOCK, lock, trace_start);
+        return;
+    }
+    if (mtx_trylock(lock) == thrd_success) {
+        queue_stats_record_lock_wait(stats, 0);
+        queue_trace_end(QUEUE_TRACE_LOCK, lock, trace_start);
+        return;
+    }
+    wait_start = queue_stats_now();
+    mtx_lock(lock);
+    queue_stats_record_lock_wait(stats, queue_stats_now() - wait_start);
+    queue_trace_end(QUEUE_TRACE_LOCK, lock, trace_start);
+}
+
+/**
+ * @brief Returns the current time for every QUEUE_STATS_SOJOURN_SAMPLE_INTERVAL'th call of the calling thread.
+ *
+ * Sampling keeps the clock reads off most enqueues while still filling the sojourn histogram at any
+ * meaningful rate.
+ *
+ * @param stats The statistics block, NULL while statistics are disabled.
+ *
+ * @return A monotonic timestamp in nanoseconds, or 0 if stats is NULL or the item is not sampled.
+ *
+ */
+uint64_t queue_stats_sample_time(QueueStats *stats) {
+    if (stats == NULL) {
+        return 0;
+    }
+    if (sample_countdown > 0) {
+        sample_countdown--;
+        return 0;
+    }
+    sample_countdown = QUEUE_STATS_SOJOURN_SAMPLE_INTERVAL - 1;
+    return queue_stats_now();
+}
+
+/**
+ * @brief Records the time a sampled item spent in the queue.
+ *
+ * @param stats The statistics block, NULL while statistics are disabled.
+ * @param enqueue_time The timestamp returned by queue_stats_sample_time when the item was enqueued.
+ *
+ */
+void queue_stats_record_sojourn(QueueStats *stats, uint64_t enqueue_time) {
+    // Variable declaration
+    uint64_t now;
+
+    if (stats == NULL || enqueue_time == 0) {
+        return;
+    }
+    now = queue_stats_now();
+    atomic_fetch_add_explicit(&current_shard(stats)->sojourn_histogram[histogram_bucket(now - enqueue_time)], 1,
+                              memory_order_relaxed);
+}
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds, never 0 so it can mark an item as sampled.
+ *
+ */
+uint64_t queue_stats_now(void) {
+    // Variable declaration
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec + 1;
+}
+
+/**
+ * @brief Sums the shards into a snapshot while other threads keep updating them.
+ *
+ * The depth is derived from the enqueued and dequeued totals. Since they are read at slightly different
+ * times the result is clamped at 0, and the high water mark is raised to it for modes that do not track
+ * their depth on every enqueue.
+ *
+ * @param stats The statistics block to read.
+ * @param snapshot A pointer to the location in which to save the statistics.
+ *
+ */
+void queue_stats_snapshot(QueueStats *stats, QueueStatsSnapshot *snapshot) {
+    // Variable declaration
+    size_t counters[STAT_COUNTER_AMOUNT] = {0};
+    QueueStatsShard *shard;
+    int parked_threads;
+    int i;
+    int j;
+
+    memset(snapshot, 0, sizeof(QueueStatsSnapshot));
+    for (i = 0; i < QUEUE_STATS_SHARDS; i++) {
+        shard = &stats->shards[i];
+        for (j = 0; j < STAT_COUNTER_AMOUNT; j++) {
+            counters[j] += atomic_load_explicit(&shard->counters[j], memory_order_relaxed);
+        }
+        for (j = 0; j < QUEUE_STATS_BUCKETS; j++) {
+            snapshot->lock_wait_histogram[j] += atomic_load_explicit(&shard->lock_wait_histogram[j],
+                                                                     memory_order_relaxed);
+            snapshot->sojourn_histogram[j] += atomic_load_explicit(&shard->sojourn_histogram[j],
+                                                                   memory_order_relaxed);
+        }
+    }
+
+    snapshot->enqueued = counters[STAT_ENQUEUED];
+    snapshot->dequeued = counters[STAT_DEQUEUED];
+    snapshot->try_hits = counters[STAT_TRY_HITS];
+    snapshot->try_misses = counters[STAT_TRY_MISSES];
+    snapshot->depth = snapshot->enqueued > snapshot->dequeued ? snapshot->enqueued - snapshot->dequeued : 0;
+    queue_stats_record_depth(stats, snapshot->depth);
+    snapshot->high_water_mark = atomic_load_explicit(&stats->high_water_mark, memory_order_relaxed);
+    parked_threads = atomic_load_explicit(&stats->parked_threads, memory_order_relaxed);
+    snapshot->parked_threads = parked_threads > 0 ? (size_t)parked_threads : 0;
+}
+
+/*Private methods*/
+
+/**
+ * @brief Returns the calling thread's shard, assigning threads to shards round robin on first use.
+ *
+ * @note Used by queue_stats_add, queue_stats_record_lock_wait and queue_stats_record_sojourn.
+ *
+ */
+static QueueStatsShard* current_shard(QueueStats *stats) {
+    if (shard_index < 0) {
+        shard_index = (int)(atomic_fetch_add_explicit(&next_shard, 1, memory_order_relaxed) % QUEUE_STATS_SHARDS);
+    }
+    return &stats->shards[shard_index];
+}
+
+/**
+ * @brief Maps a duration to its log2 histogram bucket.
+ *
+ * @param duration_ns The duration in nanoseconds.
+ *
+ * @return 0 for 0, otherwise the bit length of duration_ns capped at QUEUE_STATS_BUCKETS - 1.
+ *
+ * @note Used by queue_stats_record_lock_wait and queue_stats_record_sojourn.
+ *
+ */
+static int histogram_bucket(uint64_t duration_ns) {
+    // Variable declaration
+    int bucket;
+
+    if (duration_ns == 0) {
+        return 0;
+    }
+    bucket = 64 - __builtin_clzll(duration_ns);
+    return bucket < QUEUE_STATS_BUCKETS ? bucket : QUEUE_STATS_BUCKETS - 1;
+}
+
+/* Used sources
+    1. Atomics: https://en.cppreference.com/w/c/atomic
+    2. Monotonic clock: https://man7.org/linux/man-pages/man3/clock_gettime.3.html
+*/
@@ -0,0 +1,102 @@
+#ifndef QUEUE_STATS_H
+#define QUEUE_STATS_H
+
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+#include "queue_internal.h"
+
+// Constants
+#define QUEUE_STATS_SHARDS 16
+
+// Struct defs
+typedef enum {
+    STAT_ENQUEUED,
+    STAT_DEQUEUED,
+    STAT_TRY_HITS,
+    STAT_TRY_MISSES,
+    STAT_COUNTER_AMOUNT,
+} QueueStatCounter;
+
+typedef struct {
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t counters[STAT_COUNTER_AMOUNT];
+    atomic_size_t lock_wait_histogram[QUEUE_STATS_BUCKETS];
+    atomic_size_t sojourn_histogram[QUEUE_STATS_BUCKETS];
+} QueueStatsShard;
+
+typedef struct QueueStats {
+    QueueStatsShard shards[QUEUE_STATS_SHARDS];
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t high_water_mark;
+    atomic_int parked_threads;
+} QueueStats;
+
+/**
+ * @brief Allocates a zeroed, cache line aligned statistics block.
+ *
+ * @return A pointer to the new block, or NULL if memory allocation failed.
+ */
+QueueStats* queue_stats_create(void);
+
+/**
+ * @brief Frees a statistics block.
+ */
+void queue_stats_destroy(QueueStats *stats);
+
+/**
+ * @brief Adds amount to a counter in the calling thread's shard. Does nothing if stats is NULL.
+ */
+void queue_stats_add(QueueStats *stats, QueueStatCounter counter, size_t amount);
+
+/**
+ * @brief Raises the high water mark to depth if depth exceeds it. Does nothing if stats is NULL.
+ */
+void queue_stats_record_depth(QueueStats *stats, size_t depth);
+
+/**
+ * @brief Returns the depth of the queue derived from the enqueued and dequeued totals of every shard.
+ */
+size_t queue_stats_depth(QueueStats *stats);
+
+/**
+ * @brief Adds delta to the amount of threads blocked in the queue. Does nothing if stats is NULL.
+ */
+void queue_stats_parked(QueueStats *stats, int delta);
+
+/**
+ * @brief Records a lock acquisition that waited wait_ns nanoseconds. Does nothing if stats is NULL.
+ */
+void queue_stats_record_lock_wait(QueueStats *stats, uint64_t wait_ns);
+
+/**
+ * @brief Locks lock, recording the time spent waiting for it if stats is not NULL.
+ */
+void queue_stats_lock(QueueStats *stats, mtx_t *lock);
+
+/**
+ * @brief Returns the current time for every QUEUE_STATS_SOJOURN_SAMPLE_INTERVAL'th call of the calling thread.
+ *
+ * @return A monotonic timestamp in nanoseconds to store with an enqueued item, or 0 if stats is NULL or
+ * the item is not sampled.
+ */
+uint64_t queue_stats_sample_time(QueueStats *stats);
+
+/**
+ * @brief Records the sojourn time of an item enqueued at enqueue_time. Does nothing if stats is NULL or
+ * enqueue_time is 0.
+ */
+void queue_stats_record_sojourn(QueueStats *stats, uint64_t enqueue_time);
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ */
+uint64_t queue_stats_now(void);
+
+/**
+ * @brief Sums the shards into a snapshot while other threads keep updating them.
+ */
+void queue_stats_snapshot(QueueStats *stats, QueueStatsSnapshot *snapshot);
+
+#endif
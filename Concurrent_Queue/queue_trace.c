@@ -0,0 +1,448 @@
+// Includes
+#define _GNU_SOURCE
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "queue.h"
+#include "queue_internal.h"
+#include "queue_trace.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Global variables declarations
+atomic_bool queue_trace_enabled;
+
+#ifdef QUEUE_TRACE
+
+// Constants
+#define TRACE_FILE_MAGIC "CQTRACE1"
+
+// Struct defs
+typedef struct {
+    atomic_uint_least64_t timestamp;
+    atomic_uint_least64_t duration;
+    atomic_uintptr_t object;
+    atomic_uint_least32_t amount;
+    atomic_uint_least32_t type;
+} TraceSlot;
+
+typedef struct TraceBuffer {
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t claimed;
+    atomic_size_t written;
+    struct TraceBuffer *next;
+    uint32_t thread_id;
+    TraceSlot slots[QUEUE_TRACE_BUFFER_EVENTS];
+} TraceBuffer;
+
+typedef struct {
+    uint64_t timestamp;
+    uint64_t duration;
+    uint64_t object;
+    uint32_t amount;
+    uint32_t type;
+} TraceRecord;
+
+typedef struct {
+    char magic[8];
+    double ticks_per_ns;
+    uint64_t epoch_timestamp;
+    uint32_t thread_amount;
+    uint32_t record_size;
+} TraceFileHeader;
+
+typedef struct {
+    uint32_t thread_id;
+    uint32_t record_amount;
+} TraceThreadHeader;
+
+// Function declaration
+static TraceBuffer* create_thread_buffer(void);
+static size_t snapshot_buffer(TraceBuffer*, TraceRecord*, uint64_t);
+static double ticks_per_ns(void);
+static uint64_t monotonic_ns(void);
+
+// Global variables declarations
+static _Atomic(TraceBuffer*) trace_buffers;
+static atomic_uint_least64_t epoch_timestamp;
+static atomic_uint_least64_t epoch_ns;
+static _Thread_local TraceBuffer *thread_buffer;
+static const char *const trace_type_names[QUEUE_TRACE_TYPE_AMOUNT] = {
+    "enqueue",
+    "dequeue",
+    "park",
+    "wake",
+    "lock",
+};
+
+/*Interface methods*/
+
+/**
+ * @brief Starts recording queue events in every thread.
+ *
+ * Events recorded before the call are left out of the following dumps, so a trace starts clean without
+ * touching buffers other threads are writing to. The call also starts the calibration of the timestamp
+ * counter against the monotonic clock, which the dumps finish.
+ *
+ * @return Always true when built with QUEUE_TRACE.
+ *
+ */
+bool queueTraceStart(void) {
+    atomic_store_explicit(&epoch_ns, monotonic_ns(), memory_order_relaxed);
+    atomic_store_explicit(&epoch_timestamp, queue_trace_timestamp(), memory_order_relaxed);
+    atomic_store_explicit(&queue_trace_enabled, true, memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Stops recording queue events. The recorded events are kept for the dumps.
+ *
+ */
+void queueTraceStop(void) {
+    atomic_store_explicit(&queue_trace_enabled, false, memory_order_relaxed);
+}
+
+/**
+ * @brief Writes the events recorded since the last queueTraceStart as a Chrome trace.
+ *
+ * Enqueues, dequeues and wakes become instant events and parks and lock acquisitions complete events
+ * whose duration is the time spent waiting. Timestamps are converted to microseconds since the start of
+ * the trace.
+ *
+ * @param path The file to write, replaced if it exists.
+ *
+ * @return True on success, false if the file could not be written or memory allocation failed.
+ *
+ */
+bool queueTraceDumpChrome(const char *path) {
+    // Variable declaration
+    FILE *file;
+    TraceBuffer *buffer;
+    TraceRecord *records;
+    TraceRecord *record;
+    uint64_t epoch;
+    double ns_per_tick;
+    size_t record_amount;
+    size_t i;
+    bool first_event = true;
+    int process_id = (int)getpid();
+
+    records = malloc(QUEUE_TRACE_BUFFER_EVENTS * sizeof(TraceRecord));
+    if (records == NULL) {
+        return false;
+    }
+    file = fopen(path, "w");
+    if (file == NULL) {
+        free(records);
+        return false;
+    }
+
+    epoch = atomic_load_explicit(&epoch_timestamp, memory_order_relaxed);
+    ns_per_tick = 1.0 / ticks_per_ns();
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (buffer = atomic_load_explicit(&trace_buffers, memory_order_acquire); buffer != NULL; buffer = buffer->next) {
+        record_amount = snapshot_buffer(buffer, records, epoch);
+        for (i = 0; i < record_amount; i++) {
+            record = &records[i];
+            fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"queue\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,",
+                    first_event ? "" : ",", trace_type_names[record->type], process_id, buffer->thread_id,
+                    (double)(record->timestamp - epoch) * ns_per_tick / 1000.0);
+            if (record->type == QUEUE_TRACE_PARK || record->type == QUEUE_TRACE_LOCK) {
+                fprintf(file, "\"ph\":\"X\",\"dur\":%.3f,", (double)record->duration * ns_per_tick / 1000.0);
+            }
+            else {
+                fprintf(file, "\"ph\":\"i\",\"s\":\"t\",");
+            }
+            fprintf(file, "\"args\":{\"object\":\"0x%llx\",\"amount\":%u}}",
+                    (unsigned long long)record->object, record->amount);
+            first_event = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    free(records);
+    return fclose(file) == 0;
+}
+
+/**
+ * @brief Writes the events recorded since the last queueTraceStart in the binary trace format.
+ *
+ * The file is a TraceFileHeader followed by one block per thread, a TraceThreadHeader and its
+ * TraceRecords in recording order, all in the byte order of the machine. A timestamp converts to
+ * nanoseconds since the start of the trace as (timestamp - epoch_timestamp) / ticks_per_ns.
+ *
+ * @param path The file to write, replaced if it exists.
+ *
+ * @return True on success, false if the file could not be written or memory allocation failed.
+ *
+ */
+bool queueTraceDumpBinary(const char *path) {
+    // Variable declaration
+    FILE *file;
+    TraceBuffer *first_buffer;
+    TraceBuffer *buffer;
+    TraceRecord *records;
+    TraceFileHeader file_header;
+    TraceThreadHeader thread_header;
+    bool written = true;
+
+    records = malloc(QUEUE_TRACE_BUFFER_EVENTS * sizeof(TraceRecord));
+    if (records == NULL) {
+        return false;
+    }
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        free(records);
+        return false;
+    }
+
+    // Buffers are only ever pushed in front, so the list from first_buffer on does not change
+    first_buffer = atomic_load_explicit(&trace_buffers, memory_order_acquire);
+    memset(&file_header, 0, sizeof(file_header));
+    memcpy(file_header.magic, TRACE_FILE_MAGIC, sizeof(file_header.magic));
+    file_header.ticks_per_ns = ticks_per_ns();
+    file_header.epoch_timestamp = atomic_load_explicit(&epoch_timestamp, memory_order_relaxed);
+    file_header.record_size = sizeof(TraceRecord);
+    for (buffer = first_buffer; buffer != NULL; buffer = buffer->next) {
+        file_header.thread_amount++;
+    }
+    written = fwrite(&file_header, sizeof(file_header), 1, file) == 1;
+
+    for (buffer = first_buffer; buffer != NULL && written; buffer = buffer->next) {
+        thread_header.thread_id = buffer->thread_id;
+        thread_header.record_amount = (uint32_t)snapshot_buffer(buffer, records, file_header.epoch_timestamp);
+        written = fwrite(&thread_header, sizeof(thread_header), 1, file) == 1 &&
+                  fwrite(records, sizeof(TraceRecord), thread_header.record_amount, file) ==
+                  thread_header.record_amount;
+    }
+
+    free(records);
+    return fclose(file) == 0 && written;
+}
+
+/**
+ * @brief Appends an event to the calling thread's trace buffer.
+ *
+ * The buffer has a single writer, its thread, and is overwritten once full, so recording never waits
+ * and never takes a lock. claimed is raised before a slot is written and written after, which lets a
+ * concurrent dump tell the slots it may have read half written.
+ *
+ * @param type The type of the event.
+ * @param object The queue, lock or wait word the event happened on.
+ * @param start The timestamp the event started at for a span, or 0 for an instant event.
+ * @param amount The amount of items the event moved.
+ *
+ * @note Used by queue_trace_instant and queue_trace_end.
+ *
+ */
+void queue_trace_record(QueueTraceType type, const void *object, uint64_t start, size_t amount) {
+    // Variable declaration
+    TraceBuffer *buffer = thread_buffer;
+    TraceSlot *slot;
+    uint64_t now;
+    size_t position;
+
+    now = queue_trace_timestamp();
+    if (buffer == NULL) {
+        buffer = create_thread_buffer();
+        if (buffer == NULL) {
+            return;
+        }
+    }
+
+    position = atomic_load_explicit(&buffer->written, memory_order_relaxed);
+    slot = &buffer->slots[position & (QUEUE_TRACE_BUFFER_EVENTS - 1)];
+    atomic_store_explicit(&buffer->claimed, position + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&slot->timestamp, start != 0 ? start : now, memory_order_relaxed);
+    atomic_store_explicit(&slot->duration, start != 0 ? now - start : 0, memory_order_relaxed);
+    atomic_store_explicit(&slot->object, (uintptr_t)object, memory_order_relaxed);
+    atomic_store_explicit(&slot->amount, (uint_least32_t)amount, memory_order_relaxed);
+    atomic_store_explicit(&slot->type, (uint_least32_t)type, memory_order_relaxed);
+    atomic_store_explicit(&buffer->written, position + 1, memory_order_release);
+}
+
+/**
+ * @brief Reads the timestamp counter, the TSC on x86 and the monotonic clock elsewhere.
+ *
+ * @return The current timestamp, never 0.
+ *
+ */
+uint64_t queue_trace_timestamp(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc() | 1;
+#else
+    return monotonic_ns();
+#endif
+}
+
+/*Private methods*/
+
+/**
+ * @brief Allocates the calling thread's trace buffer and pushes it onto the list of buffers.
+ *
+ * Buffers outlive their threads, so the events of a thread that exited are still dumped.
+ *
+ * @return The new buffer, or NULL if memory allocation failed.
+ *
+ * @note Used by queue_trace_record.
+ *
+ */
+static TraceBuffer* create_thread_buffer(void) {
+    // Variable declaration
+    TraceBuffer *buffer;
+    TraceBuffer *first_buffer;
+
+    buffer = aligned_alloc(QUEUE_CACHE_LINE, sizeof(TraceBuffer));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    memset(buffer, 0, sizeof(TraceBuffer));
+    buffer->thread_id = (uint32_t)syscall(SYS_gettid);
+
+    first_buffer = atomic_load_explicit(&trace_buffers, memory_order_relaxed);
+    do {
+        buffer->next = first_buffer;
+    } while (!atomic_compare_exchange_weak_explicit(&trace_buffers, &first_buffer, buffer,
+                                                    memory_order_release, memory_order_relaxed));
+    thread_buffer = buffer;
+    return buffer;
+}
+
+/**
+ * @brief Copies the events of a buffer that are newer than epoch while its thread keeps recording.
+ *
+ * The slots are read first and claimed after, every slot the thread may have been rewriting meanwhile
+ * is dropped.
+ *
+ * @param buffer The buffer to copy.
+ * @param records The array in which to save the events, of QUEUE_TRACE_BUFFER_EVENTS records.
+ * @param epoch The timestamp of the start of the trace.
+ *
+ * @return The amount of events copied.
+ *
+ * @note Used by queueTraceDumpChrome and queueTraceDumpBinary.
+ *
+ */
+static size_t snapshot_buffer(TraceBuffer *buffer, TraceRecord *records, uint64_t epoch) {
+    // Variable declaration
+    TraceSlot *slot;
+    size_t written;
+    size_t claimed;
+    size_t first_position;
+    size_t position;
+    size_t record_amount = 0;
+    size_t valid_amount = 0;
+
+    written = atomic_load_explicit(&buffer->written, memory_order_acquire);
+    first_position = written > QUEUE_TRACE_BUFFER_EVENTS ? written - QUEUE_TRACE_BUFFER_EVENTS : 0;
+    for (position = first_position; position < written; position++) {
+        slot = &buffer->slots[position & (QUEUE_TRACE_BUFFER_EVENTS - 1)];
+        records[record_amount].timestamp = atomic_load_explicit(&slot->timestamp, memory_order_relaxed);
+        records[record_amount].duration = atomic_load_explicit(&slot->duration, memory_order_relaxed);
+        records[record_amount].object = atomic_load_explicit(&slot->object, memory_order_relaxed);
+        records[record_amount].amount = atomic_load_explicit(&slot->amount, memory_order_relaxed);
+        records[record_amount].type = atomic_load_explicit(&slot->type, memory_order_relaxed);
+        record_amount++;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    claimed = atomic_load_explicit(&buffer->claimed, memory_order_relaxed);
+
+    // Slots below claimed - capacity may have been overwritten while they were read
+    for (position = first_position; position < written; position++) {
+        if (position + QUEUE_TRACE_BUFFER_EVENTS < claimed || records[position - first_position].timestamp < epoch ||
+            records[position - first_position].type >= QUEUE_TRACE_TYPE_AMOUNT) {
+            continue;
+        }
+        records[valid_amount++] = records[position - first_position];
+    }
+    return valid_amount;
+}
+
+/**
+ * @brief Finishes the calibration of the timestamp counter started by queueTraceStart.
+ *
+ * @return The amount of timestamp ticks per nanosecond, 1 if too little time passed to tell.
+ *
+ * @note Used by queueTraceDumpChrome and queueTraceDumpBinary.
+ *
+ */
+static double ticks_per_ns(void) {
+    // Variable declaration
+    uint64_t elapsed_ticks;
+    uint64_t elapsed_ns;
+
+    elapsed_ticks = queue_trace_timestamp() - atomic_load_explicit(&epoch_timestamp, memory_order_relaxed);
+    elapsed_ns = monotonic_ns() - atomic_load_explicit(&epoch_ns, memory_order_relaxed);
+    if (elapsed_ns < 1000 || elapsed_ticks == 0) {
+        return 1.0;
+    }
+    return (double)elapsed_ticks / (double)elapsed_ns;
+}
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ *
+ * @note Used by queueTraceStart, queue_trace_timestamp and ticks_per_ns.
+ *
+ */
+static uint64_t monotonic_ns(void) {
+    // Variable declaration
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec + 1;
+}
+
+#else
+
+/*Interface methods*/
+
+/**
+ * @brief Tracing was not compiled in, build with -DQUEUE_TRACE (make TRACE=1) to enable it.
+ *
+ * @return Always false.
+ *
+ */
+bool queueTraceStart(void) {
+    return false;
+}
+
+void queueTraceStop(void) {
+}
+
+bool queueTraceDumpChrome(const char *path) {
+    (void)path;
+    return false;
+}
+
+bool queueTraceDumpBinary(const char *path) {
+    (void)path;
+    return false;
+}
+
+void queue_trace_record(QueueTraceType type, const void *object, uint64_t start, size_t amount) {
+    (void)type;
+    (void)object;
+    (void)start;
+    (void)amount;
+}
+
+uint64_t queue_trace_timestamp(void) {
+    return 0;
+}
+
+#endif
+
+/* Used sources
+    1. Chrome trace event format: https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+    2. Seqlocks and the C11 memory model: https://www.hpl.hp.com/techreports/2012/HPL-2012-68.pdf
+    3. Time stamp counter: https://en.wikipedia.org/wiki/Time_Stamp_Counter
+*/
@@ -0,0 +1,86 @@
+#ifndef QUEUE_TRACE_H
+#define QUEUE_TRACE_H
+
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Constants
+#define QUEUE_TRACE_BUFFER_EVENTS 16384
+
+// Struct defs
+typedef enum {
+    QUEUE_TRACE_ENQUEUE,
+    QUEUE_TRACE_DEQUEUE,
+    QUEUE_TRACE_PARK,
+    QUEUE_TRACE_WAKE,
+    QUEUE_TRACE_LOCK,
+    QUEUE_TRACE_TYPE_AMOUNT,
+} QueueTraceType;
+
+// Global variables declarations
+extern atomic_bool queue_trace_enabled;
+
+/**
+ * @brief Appends an event to the calling thread's trace buffer, creating the buffer on the thread's first event.
+ *
+ * @param type The type of the event.
+ * @param object The queue, lock or wait word the event happened on.
+ * @param start The timestamp the event started at for a span, or 0 for an instant event.
+ * @param amount The amount of items the event moved, 1 for events that move none.
+ */
+void queue_trace_record(QueueTraceType type, const void *object, uint64_t start, size_t amount);
+
+/**
+ * @brief Returns the timestamp counter used by the trace, the TSC on x86.
+ */
+uint64_t queue_trace_timestamp(void);
+
+/**
+ * @brief Records an instant event while tracing is enabled. Without QUEUE_TRACE it compiles to nothing,
+ * with it a disabled trace costs a single relaxed load and branch.
+ */
+static inline void queue_trace_instant(QueueTraceType type, const void *object, size_t amount) {
+#ifdef QUEUE_TRACE
+    if (atomic_load_explicit(&queue_trace_enabled, memory_order_relaxed)) {
+        queue_trace_record(type, object, 0, amount);
+    }
+#else
+    (void)type;
+    (void)object;
+    (void)amount;
+#endif
+}
+
+/**
+ * @brief Starts a span event.
+ *
+ * @return The start timestamp to hand to queue_trace_end, or 0 while tracing is disabled.
+ */
+static inline uint64_t queue_trace_begin(void) {
+#ifdef QUEUE_TRACE
+    if (atomic_load_explicit(&queue_trace_enabled, memory_order_relaxed)) {
+        return queue_trace_timestamp();
+    }
+#endif
+    return 0;
+}
+
+/**
+ * @brief Ends a span event started by queue_trace_begin. Does nothing if start is 0.
+ */
+static inline void queue_trace_end(QueueTraceType type, const void *object, uint64_t start) {
+#ifdef QUEUE_TRACE
+    if (start != 0) {
+        queue_trace_record(type, object, start, 1);
+    }
+#else
+    (void)type;
+    (void)object;
+    (void)start;
+#endif
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef QUEUE_TYPED_H
+#define QUEUE_TYPED_H
+
+// Includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "queue.h"
+
+/**
+ * @brief Declares a queue of values of a fixed type on top of the value interface of queue.h.
+ *
+ * QUEUE_DECLARE_TYPED(EventQueue, Event) declares the handle type EventQueue and the static inline
+ * functions EventQueueCreate, EventQueueDestroy, EventQueueEnqueue, EventQueueEnqueuePriority,
+ * EventQueueDequeue, EventQueueTryDequeue, EventQueueEnqueueBatch, EventQueueDequeueBatch and
+ * EventQueueVisited. The queue
+ * is created with element_size set to sizeof(Event), so values are copied into the queue's own storage
+ * and passed around by value, and the compiler checks the type of every value handed to it. The handle
+ * is a ConcurrentQueue under another name and may be cast back to one, e.g. for queueStats.
+ *
+ * @param name The name of the handle type, which prefixes the name of every function.
+ * @param type The type of the values.
+ */
+#define QUEUE_DECLARE_TYPED(name, type)                                                                     \
+    typedef struct name name;                                                                               \
+                                                                                                            \
+    /* Creates the queue with config, or with the default configuration if config is NULL. */              \
+    static inline name* name##Create(const QueueConfig *config) {                                           \
+        QueueConfig typed_config;                                                                           \
+        if (config == NULL) {                                                                               \
+            queueDefaultConfig(&typed_config);                                                              \
+        }                                                                                                   \
+        else {                                                                                              \
+            typed_config = *config;                                                                         \
+        }                                                                                                   \
+        typed_config.element_size = sizeof(type);                                                           \
+        return (name*)queueCreateWithConfig(&typed_config);                                                 \
+    }                                                                                                       \
+                                                                                                            \
+    static inline void name##Destroy(name *queue) {                                                         \
+        queueDestroy((ConcurrentQueue*)queue);                                                              \
+    }                                                                                                       \
+                                                                                                            \
+    static inline bool name##Enqueue(name *queue, type value) {                                             \
+        return queueEnqueueValue((ConcurrentQueue*)queue, &value);                                          \
+    }                                                                                                       \
+                                                                                                            \
+    static inline bool name##EnqueuePriority(name *queue, type value, unsigned int priority) {              \
+        return queueEnqueueValuePriority((ConcurrentQueue*)queue, &value, priority);                        \
+    }                                                                                                       \
+                                                                                                            \
+    static inline type name##Dequeue(name *queue) {                                                         \
+        type value;                                                                                         \
+        queueDequeueValue((ConcurrentQueue*)queue, &value);                                                 \
+        return value;                                                                                       \
+    }                                                                                                       \
+                                                                                                            \
+    static inline bool name##TryDequeue(name *queue, type *value) {                                         \
+        return queueTryDequeueValue((ConcurrentQueue*)queue, value);                                        \
+    }                                                                                                       \
+                                                                                                            \
+    static inline size_t name##EnqueueBatch(name *queue, const type *values, size_t amount) {               \
+        return queueEnqueueValueBatch((ConcurrentQueue*)queue, values, amount);                             \
+    }                                                                                                       \
+                                                                                                            \
+    static inline size_t name##DequeueBatch(name *queue, type *values, size_t max_values, size_t min_values, \
+                                            const struct timespec *deadline) {                              \
+        return queueDequeueValueBatch((ConcurrentQueue*)queue, values, max_values, min_values, deadline);   \
+    }                                                                                                       \
+                                                                                                            \
+    static inline size_t name##Visited(name *queue) {                                                       \
+        return queueVisited((ConcurrentQueue*)queue);                                                       \
+    }
+
+#endif
@@ -0,0 +1,374 @@
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+#include "parker.h"
+#include "queue_internal.h"
+#include "queue_stats.h"
+
+// Struct defs
+typedef struct {
+    atomic_size_t sequence;
+    uint64_t enqueue_time;
+    unsigned char value[];
+} RingSlot;
+
+typedef struct {
+    ConcurrentQueue base;
+    unsigned char *slots;
+    size_t slot_size;
+    size_t mask;
+    QueueFullPolicy full_policy;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t enqueue_position;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t dequeue_position;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t visited_items;
+    Parker not_empty;
+    Parker not_full;
+} RingQueue;
+
+typedef struct {
+    RingQueue *queue;
+    const void *value_to_enqueue;
+    void *dequeued_value;
+} RingAttempt;
+
+
+// Function declaration
+static bool ring_enqueue(ConcurrentQueue*, const void*);
+static void ring_dequeue(ConcurrentQueue*, void*);
+static bool ring_try_dequeue(ConcurrentQueue*, void*);
+static size_t ring_visited(ConcurrentQueue*);
+static void ring_destroy(ConcurrentQueue*);
+static RingSlot* slot_at(RingQueue*, size_t);
+static bool try_enqueue_slot(RingQueue*, const void*);
+static bool try_dequeue_slot(RingQueue*, void*);
+static bool attempt_enqueue(void*);
+static bool attempt_dequeue(void*);
+
+
+// Global variables declarations
+static const QueueOps ring_ops = {
+    .enqueue = ring_enqueue,
+    .dequeue = ring_dequeue,
+    .try_dequeue = ring_try_dequeue,
+    .visited = ring_visited,
+    .destroy = ring_destroy,
+};
+
+/*Interface methods*/
+
+/**
+ * @brief Creates a bounded, array backed MPMC ring whose slots carry sequence numbers.
+ *
+ * Slot i starts with sequence i. A producer may fill the slot its position maps to once the sequence
+ * equals that position, and publishes it by setting the sequence to position + 1. A consumer may empty
+ * it once the sequence equals position + 1, and hands it back to producers of the next lap by setting it
+ * to position + capacity. Values are stored inline after the sequence of their slot, so the slot stride
+ * depends on element_size.
+ *
+ * @param config The configuration of the queue, element_size, ring_capacity and full_policy are used by this mode.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ *
+ */
+ConcurrentQueue* ring_queue_create(const QueueConfig *config) {
+    // Variable declaration
+    RingQueue *queue;
+    size_t capacity;
+    size_t i;
+
+    queue = aligned_alloc(QUEUE_CACHE_LINE, sizeof(RingQueue));
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    capacity = queue_round_up_to_power_of_two(config->ring_capacity);
+    queue->slot_size = (sizeof(RingSlot) + config->element_size + _Alignof(RingSlot) - 1) &
+                       ~(_Alignof(RingSlot) - 1);
+    queue->slots = malloc(capacity * queue->slot_size);
+    if (queue->slots == NULL) {
+        free(queue);
+        return NULL;
+    }
+    queue->mask = capacity - 1;
+    for (i = 0; i < capacity; i++) {
+        atomic_init(&slot_at(queue, i)->sequence, i);
+        slot_at(queue, i)->enqueue_time = 0;
+    }
+
+    if (!parker_init(&queue->not_empty)) {
+        free(queue->slots);
+        free(queue);
+        return NULL;
+    }
+    if (!parker_init(&queue->not_full)) {
+        parker_destroy(&queue->not_empty);
+        free(queue->slots);
+        free(queue);
+        return NULL;
+    }
+
+    queue->base.ops = &ring_ops;
+    queue->full_policy = config->full_policy;
+    atomic_init(&queue->enqueue_position, 0);
+    atomic_init(&queue->dequeue_position, 0);
+    atomic_init(&queue->visited_items, 0);
+    return &queue->base;
+}
+
+/*Private methods*/
+
+/**
+ * @brief Enqueues an item, treating a full ring according to the queue's full policy.
+ *
+ * QUEUE_FULL_FAIL returns false at once, QUEUE_FULL_SPIN retries with a pause between attempts and
+ * QUEUE_FULL_BLOCK parks the producer until a consumer frees a slot. A parked producer is counted as
+ * parked in the statistics, and the depth the enqueue left the ring at is offered as high water mark.
+ *
+ * @param base The queue to enqueue into.
+ * @param element_to_enqueue The value to copy into the ring.
+ *
+ * @return True if the value was enqueued, false if the ring was full under QUEUE_FULL_FAIL.
+ *
+ * @note Used through ring_ops.
+ *
+ */
+static bool ring_enqueue(ConcurrentQueue *base, const void *element_to_enqueue) {
+    // Variable declaration
+    RingQueue *queue = (RingQueue*)base;
+    RingAttempt attempt;
+    unsigned int spins = 0;
+    size_t dequeue_position;
+    size_t enqueue_position;
+
+    switch (queue->full_policy) {
+        case QUEUE_FULL_FAIL:
+            if (!try_enqueue_slot(queue, element_to_enqueue)) {
+                return false;
+            }
+            break;
+
+        case QUEUE_FULL_SPIN:
+            while (!try_enqueue_slot(queue, element_to_enqueue)) {
+                queue_cpu_relax();
+                if (++spins % QUEUE_SPIN_YIELD_INTERVAL == 0) {
+                    thrd_yield();
+                }
+            }
+            break;
+
+        default:
+            attempt.queue = queue;
+            attempt.value_to_enqueue = element_to_enqueue;
+            if (!attempt_enqueue(&attempt)) {
+                queue_stats_parked(base->stats, 1);
+                parker_wait(&queue->not_full, attempt_enqueue, &attempt);
+                queue_stats_parked(base->stats, -1);
+            }
+            break;
+    }
+
+    if (base->stats != NULL) {
+        // Consumers may move the dequeue position past an enqueue position read before it, so it is read first
+        dequeue_position = atomic_load_explicit(&queue->dequeue_position, memory_order_acquire);
+        enqueue_position = atomic_load_explicit(&queue->enqueue_position, memory_order_relaxed);
+        queue_stats_record_depth(base->stats,
+                                 enqueue_position > dequeue_position ? enqueue_position - dequeue_position : 0);
+    }
+    parker_wake(&queue->not_empty);
+    return true;
+}
+
+/**
+ * @brief Dequeues an item, parking the calling thread while the ring is empty.
+ *
+ * A thread whose first attempt failed is counted as parked in the statistics until it got its item.
+ *
+ * @note Used through ring_ops.
+ *
+ */
+static void ring_dequeue(ConcurrentQueue *base, void *value) {
+    // Variable declaration
+    RingAttempt attempt;
+
+    attempt.queue = (RingQueue*)base;
+    attempt.dequeued_value = value;
+    if (!attempt_dequeue(&attempt)) {
+        queue_stats_parked(base->stats, 1);
+        parker_wait(&attempt.queue->not_empty, attempt_dequeue, &attempt);
+        queue_stats_parked(base->stats, -1);
+    }
+}
+
+/**
+ * @brief Tries to dequeue an item without blocking, waking up a blocked producer on success.
+ *
+ * @note Used through ring_ops and by attempt_dequeue.
+ *
+ */
+static bool ring_try_dequeue(ConcurrentQueue *base, void *item_of_element_to_dequeue) {
+    // Variable declaration
+    RingQueue *queue = (RingQueue*)base;
+
+    if (!try_dequeue_slot(queue, item_of_element_to_dequeue)) {
+        return false;
+    }
+    if (queue->full_policy == QUEUE_FULL_BLOCK) {
+        parker_wake(&queue->not_full);
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the amount of items dequeued from the ring.
+ *
+ * @note Used through ring_ops.
+ *
+ */
+static size_t ring_visited(ConcurrentQueue *base) {
+    return atomic_load_explicit(&((RingQueue*)base)->visited_items, memory_order_relaxed);
+}
+
+/**
+ * @brief Frees the slot array, the parkers and the queue. No thread may be operating on the queue.
+ *
+ * @note Used through ring_ops.
+ *
+ */
+static void ring_destroy(ConcurrentQueue *base) {
+    // Variable declaration
+    RingQueue *queue = (RingQueue*)base;
+
+    parker_destroy(&queue->not_full);
+    parker_destroy(&queue->not_empty);
+    free(queue->slots);
+    free(queue);
+}
+
+/**
+ * @brief Returns the slot a position maps to.
+ *
+ * @note Used by ring_queue_create, try_enqueue_slot and try_dequeue_slot.
+ *
+ */
+static RingSlot* slot_at(RingQueue *queue, size_t position) {
+    return (RingSlot*)(queue->slots + (position & queue->mask) * queue->slot_size);
+}
+
+/**
+ * @brief Claims the slot of the current enqueue position, if it is free, and publishes a value in it.
+ *
+ * @return True if the value was published, false if the ring was full.
+ *
+ * @note Used by ring_enqueue and attempt_enqueue.
+ *
+ */
+static bool try_enqueue_slot(RingQueue *queue, const void *element_to_enqueue) {
+    // Variable declaration
+    RingSlot *slot;
+    size_t position;
+    size_t sequence;
+    intptr_t difference;
+
+    position = atomic_load_explicit(&queue->enqueue_position, memory_order_relaxed);
+    for (;;) {
+        slot = slot_at(queue, position);
+        sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        difference = (intptr_t)sequence - (intptr_t)position;
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_position, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (difference < 0) {
+            return false;
+        }
+        else {
+            position = atomic_load_explicit(&queue->enqueue_position, memory_order_relaxed);
+        }
+    }
+
+    queue_copy_value(slot->value, element_to_enqueue, queue->base.element_size);
+    slot->enqueue_time = queue_stats_sample_time(queue->base.stats);
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Claims the slot of the current dequeue position, if it was published, and copies out its value.
+ *
+ * @return True if a value was taken, false if the ring was empty.
+ *
+ * @note Used by ring_try_dequeue.
+ *
+ */
+static bool try_dequeue_slot(RingQueue *queue, void *item_of_element_to_dequeue) {
+    // Variable declaration
+    RingSlot *slot;
+    size_t position;
+    size_t sequence;
+    intptr_t difference;
+    uint64_t enqueue_time;
+
+    position = atomic_load_explicit(&queue->dequeue_position, memory_order_relaxed);
+    for (;;) {
+        slot = slot_at(queue, position);
+        sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_position, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (difference < 0) {
+            return false;
+        }
+        else {
+            position = atomic_load_explicit(&queue->dequeue_position, memory_order_relaxed);
+        }
+    }
+
+    enqueue_time = slot->enqueue_time;
+    queue_copy_value(item_of_element_to_dequeue, slot->value, queue->base.element_size);
+    atomic_store_explicit(&slot->sequence, position + queue->mask + 1, memory_order_release);
+    atomic_fetch_add_explicit(&queue->visited_items, 1, memory_order_relaxed);
+    queue_stats_record_sojourn(queue->base.stats, enqueue_time);
+    return true;
+}
+
+/**
+ * @brief Adapts try_enqueue_slot to the parker_wait attempt signature.
+ *
+ * @note Used by ring_enqueue.
+ *
+ */
+static bool attempt_enqueue(void *context) {
+    // Variable declaration
+    RingAttempt *attempt = context;
+
+    return try_enqueue_slot(attempt->queue, attempt->value_to_enqueue);
+}
+
+/**
+ * @brief Adapts ring_try_dequeue to the parker_wait attempt signature.
+ *
+ * @note Used by ring_dequeue.
+ *
+ */
+static bool attempt_dequeue(void *context) {
+    // Variable declaration
+    RingAttempt *attempt = context;
+
+    return ring_try_dequeue(&attempt->queue->base, attempt->dequeued_value);
+}
+
+/* Used sources
+    1. Bounded MPMC queue: https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+    2. Atomics: https://en.cppreference.com/w/c/atomic
+*/
@@ -0,0 +1,504 @@
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include "node_pool.h"
+#include "queue_internal.h"
+#include "queue_stats.h"
+#include "queue_trace.h"
+
+// Struct defs
+typedef struct Segment {
+    struct Segment *next;
+    size_t sampled_index;
+    uint64_t sampled_time;
+    unsigned char values[];
+} Segment;
+
+typedef struct {
+    ConcurrentQueue base;
+    mtx_t queue_lock;
+    cnd_t item_condition;
+    cnd_t batch_condition;
+    int item_waiters;
+    int batch_waiters;
+    Segment *head_segment;
+    size_t head_index;
+    Segment *tail_segment;
+    size_t tail_index;
+    size_t queue_size;
+    size_t segment_capacity;
+    NodePool segment_pool;
+    atomic_size_t visited_items;
+} SegmentedQueue;
+
+
+// Function declaration
+static bool segmented_enqueue(ConcurrentQueue*, const void*);
+static void segmented_dequeue(ConcurrentQueue*, void*);
+static bool segmented_try_dequeue(ConcurrentQueue*, void*);
+static size_t segmented_enqueue_batch(ConcurrentQueue*, const void*, size_t);
+static size_t segmented_dequeue_batch(ConcurrentQueue*, void*, size_t, size_t, const struct timespec*);
+static size_t segmented_visited(ConcurrentQueue*);
+static void segmented_destroy(ConcurrentQueue*);
+static size_t put_items(SegmentedQueue*, const void*, size_t, uint64_t);
+static size_t take_items(SegmentedQueue*, void*, size_t);
+static void wake_waiters(SegmentedQueue*, size_t);
+static Segment* init_segment(SegmentedQueue*);
+static size_t segment_size(size_t, size_t);
+
+
+// Global variables declarations
+static const QueueOps segmented_ops = {
+    .enqueue = segmented_enqueue,
+    .dequeue = segmented_dequeue,
+    .try_dequeue = segmented_try_dequeue,
+    .enqueue_batch = segmented_enqueue_batch,
+    .dequeue_batch = segmented_dequeue_batch,
+    .visited = segmented_visited,
+    .destroy = segmented_destroy,
+};
+
+/*Interface methods*/
+
+/**
+ * @brief Creates a segmented queue, a linked list of fixed size arrays of items guarded by a single lock.
+ *
+ * Values are stored back to back in segments of segment_capacity slots of element_size bytes, so draining
+ * a deep backlog walks contiguous memory and follows one pointer per segment instead of one per item. Exhausted segments are
+ * recycled through the calling thread's cache and the queue's segment pool.
+ *
+ * @param config The configuration of the queue. segment_capacity sets the slots per segment, pool_prewarm
+ * and pool_max_retained are counted in items and rounded up to whole segments.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ *
+ */
+ConcurrentQueue* segmented_queue_create(const QueueConfig *config) {
+    // Variable declaration
+    SegmentedQueue *queue;
+    size_t capacity;
+
+    capacity = config->segment_capacity > 0 ? config->segment_capacity : 1;
+    queue = malloc(sizeof(SegmentedQueue));
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    queue->segment_capacity = capacity;
+    if (!node_pool_init(&queue->segment_pool, segment_size(capacity, config->element_size),
+                        (config->pool_prewarm + capacity - 1) / capacity,
+                        (config->pool_max_retained + capacity - 1) / capacity)) {
+        free(queue);
+        return NULL;
+    }
+    queue->head_segment = init_segment(queue);
+    if (queue->head_segment == NULL) {
+        node_pool_destroy(&queue->segment_pool);
+        free(queue);
+        return NULL;
+    }
+    if (mtx_init(&queue->queue_lock, mtx_plain) != thrd_success) {
+        free(queue->head_segment);
+        node_pool_destroy(&queue->segment_pool);
+        free(queue);
+        return NULL;
+    }
+    if (cnd_init(&queue->item_condition) != thrd_success) {
+        mtx_destroy(&queue->queue_lock);
+        free(queue->head_segment);
+        node_pool_destroy(&queue->segment_pool);
+        free(queue);
+        return NULL;
+    }
+    if (cnd_init(&queue->batch_condition) != thrd_success) {
+        cnd_destroy(&queue->item_condition);
+        mtx_destroy(&queue->queue_lock);
+        free(queue->head_segment);
+        node_pool_destroy(&queue->segment_pool);
+        free(queue);
+        return NULL;
+    }
+
+    queue->base.ops = &segmented_ops;
+    queue->item_waiters = 0;
+    queue->batch_waiters = 0;
+    queue->head_index = 0;
+    queue->tail_segment = queue->head_segment;
+    queue->tail_index = 0;
+    queue->queue_size = 0;
+    atomic_init(&queue->visited_items, 0);
+    return &queue->base;
+}
+
+/*Private methods*/
+
+/**
+ * @brief Stores a value in the tail segment and wakes up a waiting consumer if one exists.
+ *
+ * @param base The queue to enqueue into.
+ * @param element_to_enqueue The value to copy into the queue.
+ *
+ * @return True if the value was enqueued, false if a new segment was needed and could not be allocated.
+ *
+ * @note Used through segmented_ops.
+ *
+ */
+static bool segmented_enqueue(ConcurrentQueue *base, const void *element_to_enqueue) {
+    // Variable declaration
+    SegmentedQueue *queue = (SegmentedQueue*)base;
+    uint64_t enqueue_time;
+    size_t enqueued_amount;
+
+    enqueue_time = queue_stats_sample_time(base->stats);
+    queue_stats_lock(base->stats, &queue->queue_lock);
+    enqueued_amount = put_items(queue, element_to_enqueue, 1, enqueue_time);
+    wake_waiters(queue, enqueued_amount);
+    mtx_unlock(&queue->queue_lock);
+    return enqueued_amount == 1;
+}
+
+/**
+ * @brief Dequeues an item, waiting on the queue's item condition while the queue is empty.
+ *
+ * @param base The queue to dequeue from.
+ * @param value The location in which to save the dequeued value.
+ *
+ * @note Used through segmented_ops.
+ *
+ */
+static void segmented_dequeue(ConcurrentQueue *base, void *value) {
+    // Variable declaration
+    SegmentedQueue *queue = (SegmentedQueue*)base;
+    uint64_t trace_start;
+
+    queue_stats_lock(base->stats, &queue->queue_lock);
+    while (queue->queue_size == 0) {
+        queue->item_waiters++;
+        queue_stats_parked(base->stats, 1);
+        trace_start = queue_trace_begin();
+        cnd_wait(&queue->item_condition, &queue->queue_lock);
+        queue_trace_end(QUEUE_TRACE_PARK, queue, trace_start);
+        queue_stats_parked(base->stats, -1);
+        queue->item_waiters--;
+    }
+    take_items(queue, value, 1);
+    mtx_unlock(&queue->queue_lock);
+}
+
+/**
+ * @brief Dequeues the head item if the queue is not empty.
+ *
+ * @param base The queue to dequeue from.
+ * @param item_of_element_to_dequeue The location in which to save the dequeued value.
+ *
+ * @return True if an item was dequeued, false if the queue was empty.
+ *
+ * @note Used through segmented_ops.
+ *
+ */
+static bool segmented_try_dequeue(ConcurrentQueue *base, void *item_of_element_to_dequeue) {
+    // Variable declaration
+    SegmentedQueue *queue = (SegmentedQueue*)base;
+    size_t dequeued_amount;
+
+    queue_stats_lock(base->stats, &queue->queue_lock);
+    dequeued_amount = take_items(queue, item_of_element_to_dequeue, 1);
+    mtx_unlock(&queue->queue_lock);
+    return dequeued_amount == 1;
+}
+
+/**
+ * @brief Enqueues several items under a single lock acquisition, copying them into the tail segments in
+ * runs.
+ *
+ * @return The amount of items enqueued, less than amount only if a segment could not be allocated.
+ *
+ * @note Used through segmented_ops.
+ *
+ */
+static size_t segmented_enqueue_batch(ConcurrentQueue *base, const void *values, size_t amount) {
+    // Variable declaration
+    SegmentedQueue *queue = (SegmentedQueue*)base;
+    uint64_t enqueue_time;
+    size_t enqueued_amount;
+
+    enqueue_time = queue_stats_sample_time(base->stats);
+    queue_stats_lock(base->stats, &queue->queue_lock);
+    enqueued_amount = put_items(queue, values, amount, enqueue_time);
+    wake_waiters(queue, enqueued_amount);
+    mtx_unlock(&queue->queue_lock);
+    return enqueued_amount;
+}
+
+/**
+ * @brief Dequeues up to max_items items under a single lock acquisition, lingering until min_items items
+ * are available or the deadline passed.
+ *
+ * The items are copied out of the head segments in runs, so a large batch drains the queue at the speed
+ * of a memory copy.
+ *
+ * @param base The queue to dequeue from.
+ * @param values The array in which to save the dequeued values.
+ * @param max_items The maximal amount of items to dequeue.
+ * @param min_items The amount of items to wait for.
+ * @param deadline An absolute TIME_UTC deadline, or NULL to wait for min_items indefinitely.
+ *
+ * @return The amount of items dequeued.
+ *
+ * @note Used through segmented_ops.
+ *
+ */
+static size_t segmented_dequeue_batch(ConcurrentQueue *base, void *values, size_t max_items, size_t min_items,
+                                      const struct timespec *deadline) {
+    // Variable declaration
+    SegmentedQueue *queue = (SegmentedQueue*)base;
+    size_t dequeued_amount;
+    int wait_result = thrd_success;
+    uint64_t trace_start;
+
+    queue_stats_lock(base->stats, &queue->queue_lock);
+
+    while (queue->queue_size < min_items && wait_result != thrd_timedout) {
+        queue->batch_waiters++;
+        queue_stats_parked(base->stats, 1);
+        trace_start = queue_trace_begin();
+        if (deadline == NULL) {
+            wait_result = cnd_wait(&queue->batch_condition, &queue->queue_lock);
+        }
+        else {
+            wait_result = cnd_timedwait(&queue->batch_condition, &queue->queue_lock, deadline);
+        }
+        queue_trace_end(QUEUE_TRACE_PARK, queue, trace_start);
+        queue_stats_parked(base->stats, -1);
+        queue->batch_waiters--;
+    }
+
+    dequeued_amount = take_items(queue, values, max_items);
+
+    mtx_unlock(&queue->queue_lock);
+    return dequeued_amount;
+}
+
+/**
+ * @brief Returns the amount of items dequeued from the queue.
+ *
+ * @note Used through segmented_ops.
+ *
+ */
+static size_t segmented_visited(ConcurrentQueue *base) {
+    return atomic_load_explicit(&((SegmentedQueue*)base)->visited_items, memory_order_relaxed);
+}
+
+/**
+ * @brief Frees every segment of the queue, the segment pool, the conditions, the lock and the queue.
+ *
+ * No thread may be operating on the queue while it is destroyed.
+ *
+ * @note Used through segmented_ops.
+ *
+ */
+static void segmented_destroy(ConcurrentQueue *base) {
+    // Variable declaration
+    SegmentedQueue *queue = (SegmentedQueue*)base;
+    Segment *current_segment;
+    Segment *next_segment;
+
+    current_segment = queue->head_segment;
+    while (current_segment != NULL) {
+        next_segment = current_segment->next;
+        free(current_segment);
+        current_segment = next_segment;
+    }
+
+    node_pool_destroy(&queue->segment_pool);
+    cnd_destroy(&queue->batch_condition);
+    cnd_destroy(&queue->item_condition);
+    mtx_destroy(&queue->queue_lock);
+    free(queue);
+}
+
+/**
+ * @brief Copies values into the tail segment in runs, linking a new segment whenever the tail one is full.
+ *
+ * A segment keeps at most one sojourn sample, the first sampled run stored in it, which is plenty at the
+ * rate queue_stats_sample_time samples at.
+ *
+ * @param queue The queue to enqueue into, its lock must be held by the caller.
+ * @param values The values to enqueue.
+ * @param amount The amount of values.
+ * @param enqueue_time The sampled enqueue time of the first value, 0 if it is not sampled.
+ *
+ * @return The amount of items stored.
+ *
+ * @note Used by segmented_enqueue and segmented_enqueue_batch.
+ *
+ */
+static size_t put_items(SegmentedQueue *queue, const void *values, size_t amount, uint64_t enqueue_time) {
+    // Variable declaration
+    const unsigned char *value_bytes = values;
+    size_t element_size = queue->base.element_size;
+    Segment *new_segment;
+    size_t stored_amount = 0;
+    size_t run;
+
+    while (stored_amount < amount) {
+        if (queue->tail_index == queue->segment_capacity) {
+            new_segment = init_segment(queue);
+            if (new_segment == NULL) {
+                break;
+            }
+            queue->tail_segment->next = new_segment;
+            queue->tail_segment = new_segment;
+            queue->tail_index = 0;
+        }
+
+        run = queue->segment_capacity - queue->tail_index;
+        if (run > amount - stored_amount) {
+            run = amount - stored_amount;
+        }
+        memcpy(&queue->tail_segment->values[queue->tail_index * element_size], value_bytes + stored_amount * element_size,
+               run * element_size);
+        if (enqueue_time != 0 && queue->tail_segment->sampled_time == 0) {
+            queue->tail_segment->sampled_index = queue->tail_index;
+            queue->tail_segment->sampled_time = enqueue_time;
+            enqueue_time = 0;
+        }
+        queue->tail_index += run;
+        stored_amount += run;
+    }
+
+    queue->queue_size += stored_amount;
+    queue_stats_record_depth(queue->base.stats, queue->queue_size);
+    return stored_amount;
+}
+
+/**
+ * @brief Copies up to max_items values out of the head segment in runs, recycling every segment it empties.
+ *
+ * Once the queue is empty both indices are rewound to the start of the single remaining segment, so a
+ * queue that is drained faster than it fills never leaves its first segment.
+ *
+ * @param queue The queue to dequeue from, its lock must be held by the caller.
+ * @param values The array in which to save the dequeued values.
+ * @param max_items The maximal amount of items to dequeue.
+ *
+ * @return The amount of items dequeued, 0 if the queue is empty.
+ *
+ * @note Used by segmented_dequeue, segmented_try_dequeue and segmented_dequeue_batch.
+ *
+ */
+static size_t take_items(SegmentedQueue *queue, void *values, size_t max_items) {
+    // Variable declaration
+    unsigned char *value_bytes = values;
+    size_t element_size = queue->base.element_size;
+    Segment *head_segment;
+    size_t taken_amount = 0;
+    size_t end_index;
+    size_t run;
+
+    while (taken_amount < max_items && queue->queue_size > 0) {
+        head_segment = queue->head_segment;
+        end_index = head_segment == queue->tail_segment ? queue->tail_index : queue->segment_capacity;
+        run = end_index - queue->head_index;
+        if (run > max_items - taken_amount) {
+            run = max_items - taken_amount;
+        }
+
+        memcpy(value_bytes + taken_amount * element_size, &head_segment->values[queue->head_index * element_size],
+               run * element_size);
+        if (head_segment->sampled_time != 0 && head_segment->sampled_index < queue->head_index + run) {
+            queue_stats_record_sojourn(queue->base.stats, head_segment->sampled_time);
+            head_segment->sampled_time = 0;
+        }
+        queue->head_index += run;
+        queue->queue_size -= run;
+        taken_amount += run;
+
+        if (queue->head_index == queue->segment_capacity && head_segment != queue->tail_segment) {
+            queue->head_segment = head_segment->next;
+            queue->head_index = 0;
+            node_pool_release(&queue->segment_pool, head_segment);
+        }
+    }
+
+    if (queue->queue_size == 0) {
+        queue->head_index = 0;
+        queue->tail_index = 0;
+    }
+    atomic_store_explicit(&queue->visited_items,
+                          atomic_load_explicit(&queue->visited_items, memory_order_relaxed) + taken_amount,
+                          memory_order_relaxed);
+    return taken_amount;
+}
+
+/**
+ * @brief Wakes up one single item waiter per enqueued item and every batch waiter.
+ *
+ * Batch waiters wait for different amounts of items, so all of them are woken to re-check the amount.
+ *
+ * @param queue The queue whose waiters to wake, its lock must be held by the caller.
+ * @param enqueued_amount The amount of items just enqueued.
+ *
+ * @note Used by segmented_enqueue and segmented_enqueue_batch.
+ *
+ */
+static void wake_waiters(SegmentedQueue *queue, size_t enqueued_amount) {
+    // Variable declaration
+    size_t i;
+
+    for (i = 0; i < enqueued_amount && i < (size_t)queue->item_waiters; i++) {
+        cnd_signal(&queue->item_condition);
+        queue_trace_instant(QUEUE_TRACE_WAKE, queue, 1);
+    }
+    if (enqueued_amount > 0 && queue->batch_waiters > 0) {
+        cnd_broadcast(&queue->batch_condition);
+        queue_trace_instant(QUEUE_TRACE_WAKE, queue, 1);
+    }
+}
+
+/**
+ * @brief Takes an empty segment from the calling thread's cache, the segment pool or the heap.
+ *
+ * @param queue The queue the segment is for, its lock must be held by the caller unless the queue is
+ * being created.
+ *
+ * @return The new segment, or NULL if memory allocation failed.
+ *
+ * @note Used by segmented_queue_create and put_items.
+ *
+ */
+static Segment* init_segment(SegmentedQueue *queue) {
+    // Variable declaration
+    Segment *new_segment;
+
+    new_segment = node_cache_take(queue->segment_pool.node_size);
+    if (new_segment == NULL) {
+        new_segment = node_pool_alloc(&queue->segment_pool);
+        if (new_segment == NULL) {
+            return NULL;
+        }
+    }
+    new_segment->next = NULL;
+    new_segment->sampled_time = 0;
+    return new_segment;
+}
+
+/**
+ * @brief Returns the size in bytes of a segment holding capacity values of element_size bytes.
+ *
+ * @note Used by segmented_queue_create.
+ *
+ */
+static size_t segment_size(size_t capacity, size_t element_size) {
+    return offsetof(Segment, values) + capacity * element_size;
+}
+
+/* Used sources
+    1. Unrolled linked list: https://en.wikipedia.org/wiki/Unrolled_linked_list
+    2. Concurrency methods: https://en.cppreference.com/w/c/thread
+*/
@@ -0,0 +1,486 @@
+// Includes
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "futex.h"
+#include "queue_internal.h"
+#include "shm_queue.h"
+
+// Constants
+#define SHM_QUEUE_MAGIC 0x53484d5155455545u
+#define SHM_QUEUE_SPIN_BUDGET 2000
+
+#if ATOMIC_LLONG_LOCK_FREE != 2 || ATOMIC_INT_LOCK_FREE != 2
+#error "The shared memory queue needs address free atomics"
+#endif
+
+// Struct defs
+typedef struct {
+    atomic_uint epoch;
+    atomic_uint waiters;
+} ShmEvent;
+
+typedef struct {
+    _Atomic uint64_t magic;
+    size_t region_size;
+    size_t mask;
+    size_t element_size;
+    size_t slot_size;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t enqueue_position;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t dequeue_position;
+    _Alignas(QUEUE_CACHE_LINE) ShmEvent not_empty;
+    _Alignas(QUEUE_CACHE_LINE) ShmEvent not_full;
+    _Alignas(QUEUE_CACHE_LINE) unsigned char slots[];
+} ShmHeader;
+
+typedef struct {
+    atomic_size_t sequence;
+    unsigned char payload[];
+} ShmSlot;
+
+struct ShmQueue {
+    ShmHeader *header;
+    size_t region_size;
+};
+
+typedef struct {
+    ShmQueue *queue;
+    const void *source;
+    void *destination;
+} ShmAttempt;
+
+
+// Function declaration
+static ShmQueue* map_region(int, size_t);
+static bool header_is_valid(ShmHeader*, size_t);
+static ShmSlot* slot_at(ShmHeader*, size_t);
+static bool attempt_enqueue(void*);
+static bool attempt_dequeue(void*);
+static void wait_for_event(ShmEvent*, bool (*)(void*), void*);
+static void notify_event(ShmEvent*);
+
+/*Interface methods*/
+
+/**
+ * @brief Creates a named shared memory region holding a bounded MPMC queue of fixed size payloads.
+ *
+ * The queue is the sequence numbered ring of QUEUE_MODE_RING with the items replaced by payload bytes
+ * stored in the slots. Slots are addressed by their offset from the start of the region, so the region
+ * may be mapped at a different address in every process. The magic number is stored last, with release
+ * ordering, so shmQueueOpen never attaches to a half initialized queue.
+ *
+ * @param name The name of the region, as for shm_open.
+ * @param capacity The amount of payloads the queue holds, rounded up to a power of two.
+ * @param element_size The size of every payload in bytes.
+ *
+ * @return A handle to the new queue, or NULL on failure.
+ *
+ */
+ShmQueue* shmQueueCreate(const char *name, size_t capacity, size_t element_size) {
+    // Variable declaration
+    ShmQueue *queue;
+    ShmHeader *header;
+    size_t slot_size;
+    size_t region_size;
+    size_t i;
+    int fd;
+
+    if (element_size == 0 || element_size > SIZE_MAX / 2) {
+        return NULL;
+    }
+    capacity = queue_round_up_to_power_of_two(capacity);
+    slot_size = (sizeof(ShmSlot) + element_size + _Alignof(ShmSlot) - 1) & ~(_Alignof(ShmSlot) - 1);
+    if (capacity > (SIZE_MAX - sizeof(ShmHeader)) / slot_size) {
+        return NULL;
+    }
+    region_size = sizeof(ShmHeader) + capacity * slot_size;
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)region_size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    queue = map_region(fd, region_size);
+    if (queue == NULL) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // ftruncate zero fills the region, so only the non zero fields are set
+    header = queue->header;
+    header->region_size = region_size;
+    header->mask = capacity - 1;
+    header->element_size = element_size;
+    header->slot_size = slot_size;
+    for (i = 0; i < capacity; i++) {
+        atomic_store_explicit(&slot_at(header, i)->sequence, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&header->magic, SHM_QUEUE_MAGIC, memory_order_release);
+    return queue;
+}
+
+/**
+ * @brief Maps a queue created by shmQueueCreate.
+ *
+ * @param name The name the queue was created with.
+ *
+ * @return A handle to the queue, or NULL if the region does not exist, could not be mapped or does not hold
+ * a fully initialized queue.
+ *
+ */
+ShmQueue* shmQueueOpen(const char *name) {
+    // Variable declaration
+    ShmQueue *queue;
+    struct stat region_stat;
+    int fd;
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &region_stat) != 0 || (size_t)region_stat.st_size < sizeof(ShmHeader)) {
+        close(fd);
+        return NULL;
+    }
+    queue = map_region(fd, (size_t)region_stat.st_size);
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    if (!header_is_valid(queue->header, (size_t)region_stat.st_size)) {
+        shmQueueClose(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+/**
+ * @brief Unmaps a queue and frees its handle.
+ *
+ * @param queue The handle to close.
+ *
+ */
+void shmQueueClose(ShmQueue *queue) {
+    munmap(queue->header, queue->region_size);
+    free(queue);
+}
+
+/**
+ * @brief Removes the name of a queue's region.
+ *
+ * @param name The name the queue was created with.
+ *
+ * @return True on success, false if the name does not exist.
+ *
+ */
+bool shmQueueUnlink(const char *name) {
+    return shm_unlink(name) == 0;
+}
+
+/**
+ * @brief Returns the payload size of a queue.
+ *
+ * @param queue The queue to query.
+ *
+ */
+size_t shmQueueElementSize(ShmQueue *queue) {
+    return queue->header->element_size;
+}
+
+/**
+ * @brief Copies a payload into the queue, sleeping on the shared not full event while it is full.
+ *
+ * @param queue The queue to enqueue into.
+ * @param payload The payload to copy.
+ *
+ */
+void shmQueueEnqueue(ShmQueue *queue, const void *payload) {
+    // Variable declaration
+    ShmAttempt attempt;
+
+    attempt.queue = queue;
+    attempt.source = payload;
+    attempt.destination = NULL;
+    wait_for_event(&queue->header->not_full, attempt_enqueue, &attempt);
+}
+
+/**
+ * @brief Claims the slot of the current enqueue position, if it is free, copies a payload into it and
+ * publishes it, waking up a sleeping consumer of any process.
+ *
+ * @param queue The queue to enqueue into.
+ * @param payload The payload to copy.
+ *
+ * @return True if the payload was enqueued, false if the queue was full.
+ *
+ */
+bool shmQueueTryEnqueue(ShmQueue *queue, const void *payload) {
+    // Variable declaration
+    ShmHeader *header = queue->header;
+    ShmSlot *slot;
+    size_t position;
+    size_t sequence;
+    intptr_t difference;
+
+    position = atomic_load_explicit(&header->enqueue_position, memory_order_relaxed);
+    for (;;) {
+        slot = slot_at(header, position);
+        sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        difference = (intptr_t)sequence - (intptr_t)position;
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&header->enqueue_position, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (difference < 0) {
+            return false;
+        }
+        else {
+            position = atomic_load_explicit(&header->enqueue_position, memory_order_relaxed);
+        }
+    }
+
+    memcpy(slot->payload, payload, header->element_size);
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    notify_event(&header->not_empty);
+    return true;
+}
+
+/**
+ * @brief Copies the head payload out of the queue, sleeping on the shared not empty event while it is empty.
+ *
+ * @param queue The queue to dequeue from.
+ * @param payload The location in which to save the payload.
+ *
+ */
+void shmQueueDequeue(ShmQueue *queue, void *payload) {
+    // Variable declaration
+    ShmAttempt attempt;
+
+    attempt.queue = queue;
+    attempt.source = NULL;
+    attempt.destination = payload;
+    wait_for_event(&queue->header->not_empty, attempt_dequeue, &attempt);
+}
+
+/**
+ * @brief Claims the slot of the current dequeue position, if it was published, copies its payload out
+ * and hands the slot back to producers, waking up a sleeping producer of any process.
+ *
+ * @param queue The queue to dequeue from.
+ * @param payload The location in which to save the payload.
+ *
+ * @return True if a payload was dequeued, false if the queue was empty.
+ *
+ */
+bool shmQueueTryDequeue(ShmQueue *queue, void *payload) {
+    // Variable declaration
+    ShmHeader *header = queue->header;
+    ShmSlot *slot;
+    size_t position;
+    size_t sequence;
+    intptr_t difference;
+
+    position = atomic_load_explicit(&header->dequeue_position, memory_order_relaxed);
+    for (;;) {
+        slot = slot_at(header, position);
+        sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&header->dequeue_position, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (difference < 0) {
+            return false;
+        }
+        else {
+            position = atomic_load_explicit(&header->dequeue_position, memory_order_relaxed);
+        }
+    }
+
+    memcpy(payload, slot->payload, header->element_size);
+    atomic_store_explicit(&slot->sequence, position + header->mask + 1, memory_order_release);
+    notify_event(&header->not_full);
+    return true;
+}
+
+/*Private methods*/
+
+/**
+ * @brief Maps a shared memory region and wraps it in a handle. Closes fd in any case.
+ *
+ * @param fd The descriptor returned by shm_open.
+ * @param region_size The size of the region.
+ *
+ * @return The new handle, or NULL if the mapping or the handle could not be allocated.
+ *
+ * @note Used by shmQueueCreate and shmQueueOpen.
+ *
+ */
+static ShmQueue* map_region(int fd, size_t region_size) {
+    // Variable declaration
+    ShmQueue *queue;
+    void *region;
+
+    region = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+    queue = malloc(sizeof(ShmQueue));
+    if (queue == NULL) {
+        munmap(region, region_size);
+        return NULL;
+    }
+    queue->header = region;
+    queue->region_size = region_size;
+    return queue;
+}
+
+/**
+ * @brief Checks that a mapped region holds an initialized queue whose geometry fits the region.
+ *
+ * The geometry is read from memory other processes write to, so it is checked before any slot is touched.
+ *
+ * @param header The start of the mapped region.
+ * @param region_size The size of the region.
+ *
+ * @return True if the queue may be used, false otherwise.
+ *
+ * @note Used by shmQueueOpen.
+ *
+ */
+static bool header_is_valid(ShmHeader *header, size_t region_size) {
+    // Variable declaration
+    size_t capacity;
+
+    if (atomic_load_explicit(&header->magic, memory_order_acquire) != SHM_QUEUE_MAGIC ||
+        header->region_size != region_size) {
+        return false;
+    }
+    capacity = header->mask + 1;
+    if (capacity == 0 || (capacity & header->mask) != 0 || header->element_size == 0 ||
+        header->slot_size < sizeof(ShmSlot) + header->element_size || header->slot_size % _Alignof(ShmSlot) != 0) {
+        return false;
+    }
+    return capacity <= (region_size - sizeof(ShmHeader)) / header->slot_size &&
+           sizeof(ShmHeader) + capacity * header->slot_size == region_size;
+}
+
+/**
+ * @brief Returns the slot a position maps to, found by its offset from the start of the slot array.
+ *
+ * @note Used by shmQueueCreate, shmQueueTryEnqueue and shmQueueTryDequeue.
+ *
+ */
+static ShmSlot* slot_at(ShmHeader *header, size_t position) {
+    return (ShmSlot*)(header->slots + (position & header->mask) * header->slot_size);
+}
+
+/**
+ * @brief Adapts shmQueueTryEnqueue to the wait_for_event attempt signature.
+ *
+ * @note Used by shmQueueEnqueue.
+ *
+ */
+static bool attempt_enqueue(void *context) {
+    // Variable declaration
+    ShmAttempt *attempt = context;
+
+    return shmQueueTryEnqueue(attempt->queue, attempt->source);
+}
+
+/**
+ * @brief Adapts shmQueueTryDequeue to the wait_for_event attempt signature.
+ *
+ * @note Used by shmQueueDequeue.
+ *
+ */
+static bool attempt_dequeue(void *context) {
+    // Variable declaration
+    ShmAttempt *attempt = context;
+
+    return shmQueueTryDequeue(attempt->queue, attempt->destination);
+}
+
+/**
+ * @brief Calls attempt until it succeeds, spinning first and then sleeping on the event's futex word.
+ *
+ * The event is an eventcount in the shared region. A waiter reads the epoch, registers itself and makes a
+ * final attempt before sleeping on the epoch it read, and notify_event bumps the epoch before waking, so
+ * a notification issued after the final attempt either changes the epoch first or wakes the waiter.
+ *
+ * @param event The event to wait on.
+ * @param attempt A non blocking operation returning true once it succeeded.
+ * @param context The argument passed to attempt.
+ *
+ * @note Used by shmQueueEnqueue and shmQueueDequeue.
+ *
+ */
+static void wait_for_event(ShmEvent *event, bool (*attempt)(void*), void *context) {
+    // Variable declaration
+    unsigned int spins;
+    unsigned int epoch;
+    bool succeeded;
+
+    for (spins = 0; spins < SHM_QUEUE_SPIN_BUDGET; spins++) {
+        if (attempt(context)) {
+            return;
+        }
+        queue_cpu_relax();
+    }
+
+    for (;;) {
+        epoch = atomic_load_explicit(&event->epoch, memory_order_relaxed);
+        atomic_fetch_add_explicit(&event->waiters, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        succeeded = attempt(context);
+        if (!succeeded) {
+            futex_wait_shared(&event->epoch, epoch);
+        }
+        atomic_fetch_sub_explicit(&event->waiters, 1, memory_order_relaxed);
+        if (succeeded) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Wakes up one waiter of an event, if any. Called after the state the waiters wait for was published.
+ *
+ * Without waiters this costs a fence and a load, so the common case makes no system call.
+ *
+ * @param event The event to notify.
+ *
+ * @note Used by shmQueueTryEnqueue and shmQueueTryDequeue.
+ *
+ */
+static void notify_event(ShmEvent *event) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&event->waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add_explicit(&event->epoch, 1, memory_order_relaxed);
+        futex_wake_shared(&event->epoch, 1);
+    }
+}
+
+/* Used sources
+    1. Shared memory: https://man7.org/linux/man-pages/man7/shm_overview.7.html
+    2. Bounded MPMC queue: https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+    3. Futex: https://man7.org/linux/man-pages/man2/futex.2.html
+*/
@@ -0,0 +1,96 @@
+#ifndef SHM_QUEUE_H
+#define SHM_QUEUE_H
+
+// Includes
+#include <stdbool.h>
+#include <stddef.h>
+
+// Struct defs
+typedef struct ShmQueue ShmQueue;
+
+/**
+ * @brief Creates a named shared memory region holding a bounded MPMC queue of fixed size payloads and
+ * maps it into the calling process.
+ *
+ * The region only holds sequence numbers, indices and payload bytes, never pointers, so every process
+ * that maps it may enqueue and dequeue. Payloads are copied into and out of the ring, so as long as the
+ * queue is neither empty nor full an operation makes no system call.
+ *
+ * @param name The name of the region, as for shm_open: a leading '/' and no other '/'.
+ * @param capacity The amount of payloads the queue holds, rounded up to a power of two.
+ * @param element_size The size of every payload in bytes, at least 1.
+ *
+ * @return A handle to the new queue, or NULL if the region exists already or could not be created or mapped.
+ */
+ShmQueue* shmQueueCreate(const char *name, size_t capacity, size_t element_size);
+
+/**
+ * @brief Maps a queue created by shmQueueCreate, in this or any other process.
+ *
+ * @param name The name the queue was created with.
+ *
+ * @return A handle to the queue, or NULL if the region does not exist, could not be mapped or does not hold
+ * a fully initialized queue yet.
+ */
+ShmQueue* shmQueueOpen(const char *name);
+
+/**
+ * @brief Unmaps a queue from the calling process and frees the handle. The region itself is kept.
+ *
+ * @param queue The handle to close.
+ */
+void shmQueueClose(ShmQueue *queue);
+
+/**
+ * @brief Removes the name of a queue's region. Processes that mapped it keep using it until they close it.
+ *
+ * @param name The name the queue was created with.
+ *
+ * @return True on success, false if the name does not exist.
+ */
+bool shmQueueUnlink(const char *name);
+
+/**
+ * @brief Returns the payload size of a queue.
+ *
+ * @param queue The queue to query.
+ */
+size_t shmQueueElementSize(ShmQueue *queue);
+
+/**
+ * @brief Copies a payload into the queue, blocking while it is full.
+ *
+ * @param queue The queue to enqueue into.
+ * @param payload The payload, shmQueueElementSize bytes.
+ */
+void shmQueueEnqueue(ShmQueue *queue, const void *payload);
+
+/**
+ * @brief Copies a payload into the queue unless it is full.
+ *
+ * @param queue The queue to enqueue into.
+ * @param payload The payload, shmQueueElementSize bytes.
+ *
+ * @return True if the payload was enqueued, false if the queue was full.
+ */
+bool shmQueueTryEnqueue(ShmQueue *queue, const void *payload);
+
+/**
+ * @brief Copies the head payload out of the queue, blocking while it is empty.
+ *
+ * @param queue The queue to dequeue from.
+ * @param payload The location in which to save the payload, shmQueueElementSize bytes.
+ */
+void shmQueueDequeue(ShmQueue *queue, void *payload);
+
+/**
+ * @brief Copies the head payload out of the queue unless it is empty.
+ *
+ * @param queue The queue to dequeue from.
+ * @param payload The location in which to save the payload, shmQueueElementSize bytes.
+ *
+ * @return True if a payload was dequeued, false if the queue was empty.
+ */
+bool shmQueueTryDequeue(ShmQueue *queue, void *payload);
+
+#endif
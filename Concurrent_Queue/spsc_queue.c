@@ -0,0 +1,473 @@
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+#include "futex.h"
+#include "queue_internal.h"
+#include "queue_stats.h"
+
+// Constants
+#define THREAD_AWAKE 0
+#define THREAD_SLEEPING 1
+
+// Struct defs
+typedef struct {
+    uint64_t enqueue_time;
+    unsigned char value[];
+} SpscSlot;
+
+typedef struct {
+    ConcurrentQueue base;
+    unsigned char *slots;
+    size_t slot_size;
+    size_t mask;
+    QueueFullPolicy full_policy;
+    unsigned int spin_budget;
+    _Alignas(QUEUE_CACHE_LINE) atomic_uint consumer_state;
+    atomic_uint producer_state;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t head;
+    size_t cached_tail;
+#ifdef QUEUE_DEBUG
+    _Atomic(void*) consumer_owner;
+#endif
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t tail;
+    size_t cached_head;
+#ifdef QUEUE_DEBUG
+    _Atomic(void*) producer_owner;
+#endif
+} SpscQueue;
+
+
+// Function declaration
+static bool spsc_enqueue(ConcurrentQueue*, const void*);
+static void spsc_dequeue(ConcurrentQueue*, void*);
+static bool spsc_try_dequeue(ConcurrentQueue*, void*);
+static size_t spsc_enqueue_batch(ConcurrentQueue*, const void*, size_t);
+static size_t spsc_visited(ConcurrentQueue*);
+static void spsc_destroy(ConcurrentQueue*);
+static SpscSlot* slot_at(SpscQueue*, size_t);
+static size_t try_enqueue_run(SpscQueue*, const void*, size_t);
+static bool has_items(SpscQueue*);
+static bool has_space(SpscQueue*);
+static void wait_until(SpscQueue*, atomic_uint*, bool (*)(SpscQueue*));
+static void wake_sleeper(atomic_uint*);
+#ifdef QUEUE_DEBUG
+static void check_role(_Atomic(void*)*);
+#endif
+
+
+// Global variables declarations
+static const QueueOps spsc_ops = {
+    .enqueue = spsc_enqueue,
+    .dequeue = spsc_dequeue,
+    .try_dequeue = spsc_try_dequeue,
+    .enqueue_batch = spsc_enqueue_batch,
+    .visited = spsc_visited,
+    .destroy = spsc_destroy,
+};
+#ifdef QUEUE_DEBUG
+static _Thread_local char thread_identity;
+#endif
+
+/*Interface methods*/
+
+/**
+ * @brief Creates a bounded single producer single consumer ring.
+ *
+ * The producer owns tail and the consumer owns head, so every operation is a handful of plain loads and
+ * stores plus one release store and completes in a bounded amount of steps. Each side keeps a private
+ * copy of the other side's index and only reloads it when the copy says the ring is full or empty, so
+ * the two cache lines are not bounced between the threads on every item. In debug builds (QUEUE_DEBUG)
+ * the first thread to enqueue and the first thread to dequeue claim their roles for the lifetime of the
+ * queue, and any other thread taking one of them aborts the program, even after a synchronized handoff.
+ * Other builds do not check the roles at all.
+ *
+ * @param config The configuration of the queue. element_size, ring_capacity and full_policy are used as in
+ * QUEUE_MODE_RING, and a blocked side spins for up to spin_budget pauses before sleeping on a futex.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ *
+ */
+ConcurrentQueue* spsc_queue_create(const QueueConfig *config) {
+    // Variable declaration
+    SpscQueue *queue;
+    size_t capacity;
+
+    queue = aligned_alloc(QUEUE_CACHE_LINE, sizeof(SpscQueue));
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    capacity = queue_round_up_to_power_of_two(config->ring_capacity);
+    queue->slot_size = (sizeof(SpscSlot) + config->element_size + _Alignof(SpscSlot) - 1) &
+                       ~(_Alignof(SpscSlot) - 1);
+    queue->slots = malloc(capacity * queue->slot_size);
+    if (queue->slots == NULL) {
+        free(queue);
+        return NULL;
+    }
+
+    queue->base.ops = &spsc_ops;
+    queue->mask = capacity - 1;
+    queue->full_policy = config->full_policy;
+    queue->spin_budget = config->spin_budget;
+    atomic_init(&queue->consumer_state, THREAD_AWAKE);
+    atomic_init(&queue->producer_state, THREAD_AWAKE);
+    atomic_init(&queue->head, 0);
+    queue->cached_tail = 0;
+    atomic_init(&queue->tail, 0);
+    queue->cached_head = 0;
+#ifdef QUEUE_DEBUG
+    atomic_init(&queue->consumer_owner, NULL);
+    atomic_init(&queue->producer_owner, NULL);
+#endif
+    return &queue->base;
+}
+
+/*Private methods*/
+
+/**
+ * @brief Enqueues an item, treating a full ring according to the queue's full policy.
+ *
+ * QUEUE_FULL_FAIL returns false at once, QUEUE_FULL_SPIN retries with a pause between attempts and
+ * QUEUE_FULL_BLOCK spins for up to spin_budget pauses before sleeping until the consumer frees a slot.
+ *
+ * @param base The queue to enqueue into.
+ * @param element_to_enqueue The value to copy into the ring.
+ *
+ * @return True if the value was enqueued, false if the ring was full under QUEUE_FULL_FAIL.
+ *
+ * @note Used through spsc_ops.
+ *
+ */
+static bool spsc_enqueue(ConcurrentQueue *base, const void *element_to_enqueue) {
+    // Variable declaration
+    SpscQueue *queue = (SpscQueue*)base;
+    unsigned int spins = 0;
+
+#ifdef QUEUE_DEBUG
+    check_role(&queue->producer_owner);
+#endif
+    while (try_enqueue_run(queue, element_to_enqueue, 1) == 0) {
+        switch (queue->full_policy) {
+            case QUEUE_FULL_FAIL:
+                return false;
+
+            case QUEUE_FULL_SPIN:
+                queue_cpu_relax();
+                if (++spins % QUEUE_SPIN_YIELD_INTERVAL == 0) {
+                    thrd_yield();
+                }
+                break;
+
+            default:
+                wait_until(queue, &queue->producer_state, has_space);
+                break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Dequeues an item, spinning for up to spin_budget pauses and then sleeping while the ring is empty.
+ *
+ * @param base The queue to dequeue from.
+ * @param value The location in which to save the dequeued value.
+ *
+ * @note Used through spsc_ops.
+ *
+ */
+static void spsc_dequeue(ConcurrentQueue *base, void *value) {
+    // Variable declaration
+    SpscQueue *queue = (SpscQueue*)base;
+
+    while (!spsc_try_dequeue(base, value)) {
+        wait_until(queue, &queue->consumer_state, has_items);
+    }
+}
+
+/**
+ * @brief Dequeues the head item if the ring is not empty, waking up a sleeping producer.
+ *
+ * The consumer only reloads tail once its cached copy says the ring is empty.
+ *
+ * @param base The queue to dequeue from.
+ * @param item_of_element_to_dequeue The location in which to save the dequeued value.
+ *
+ * @return True if an item was dequeued, false if the ring was empty.
+ *
+ * @note Used through spsc_ops and by spsc_dequeue.
+ *
+ */
+static bool spsc_try_dequeue(ConcurrentQueue *base, void *item_of_element_to_dequeue) {
+    // Variable declaration
+    SpscQueue *queue = (SpscQueue*)base;
+    SpscSlot *slot;
+    size_t head;
+    uint64_t enqueue_time;
+
+#ifdef QUEUE_DEBUG
+    check_role(&queue->consumer_owner);
+#endif
+    head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    if (head == queue->cached_tail && !has_items(queue)) {
+        return false;
+    }
+
+    slot = slot_at(queue, head);
+    queue_copy_value(item_of_element_to_dequeue, slot->value, base->element_size);
+    enqueue_time = slot->enqueue_time;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+    if (queue->full_policy == QUEUE_FULL_BLOCK) {
+        wake_sleeper(&queue->producer_state);
+    }
+    queue_stats_record_sojourn(base->stats, enqueue_time);
+    return true;
+}
+
+/**
+ * @brief Enqueues several items, publishing every run of free slots with a single store of tail.
+ *
+ * @return The amount of items enqueued, less than amount only if the ring filled up under QUEUE_FULL_FAIL.
+ *
+ * @note Used through spsc_ops.
+ *
+ */
+static size_t spsc_enqueue_batch(ConcurrentQueue *base, const void *values, size_t amount) {
+    // Variable declaration
+    SpscQueue *queue = (SpscQueue*)base;
+    const unsigned char *value_bytes = values;
+    size_t enqueued_amount = 0;
+    size_t run;
+    unsigned int spins = 0;
+
+#ifdef QUEUE_DEBUG
+    check_role(&queue->producer_owner);
+#endif
+    while (enqueued_amount < amount) {
+        run = try_enqueue_run(queue, value_bytes + enqueued_amount * base->element_size, amount - enqueued_amount);
+        enqueued_amount += run;
+        if (run > 0 || enqueued_amount == amount) {
+            continue;
+        }
+
+        switch (queue->full_policy) {
+            case QUEUE_FULL_FAIL:
+                return enqueued_amount;
+
+            case QUEUE_FULL_SPIN:
+                queue_cpu_relax();
+                if (++spins % QUEUE_SPIN_YIELD_INTERVAL == 0) {
+                    thrd_yield();
+                }
+                break;
+
+            default:
+                wait_until(queue, &queue->producer_state, has_space);
+                break;
+        }
+    }
+    return enqueued_amount;
+}
+
+/**
+ * @brief Returns the amount of items dequeued from the ring, which is the consumer's index.
+ *
+ * @note Used through spsc_ops.
+ *
+ */
+static size_t spsc_visited(ConcurrentQueue *base) {
+    return atomic_load_explicit(&((SpscQueue*)base)->head, memory_order_relaxed);
+}
+
+/**
+ * @brief Frees the slot array and the queue. No thread may be operating on the queue.
+ *
+ * @note Used through spsc_ops.
+ *
+ */
+static void spsc_destroy(ConcurrentQueue *base) {
+    // Variable declaration
+    SpscQueue *queue = (SpscQueue*)base;
+
+    free(queue->slots);
+    free(queue);
+}
+
+/**
+ * @brief Returns the slot a position maps to.
+ *
+ * @note Used by spsc_try_dequeue and try_enqueue_run.
+ *
+ */
+static SpscSlot* slot_at(SpscQueue *queue, size_t position) {
+    return (SpscSlot*)(queue->slots + (position & queue->mask) * queue->slot_size);
+}
+
+/**
+ * @brief Copies as many values as there are free slots into the ring and publishes them, waking up a
+ * sleeping consumer.
+ *
+ * The producer only reloads head once its cached copy says the ring is full. The depth is offered as
+ * high water mark on sampled enqueues only, since it needs a fresh head.
+ *
+ * @param queue The queue to enqueue into.
+ * @param values The values to enqueue.
+ * @param amount The amount of values.
+ *
+ * @return The amount of values enqueued, 0 if the ring is full.
+ *
+ * @note Used by spsc_enqueue and spsc_enqueue_batch.
+ *
+ */
+static size_t try_enqueue_run(SpscQueue *queue, const void *values, size_t amount) {
+    // Variable declaration
+    const unsigned char *value_bytes = values;
+    size_t element_size = queue->base.element_size;
+    SpscSlot *slot;
+    size_t tail;
+    size_t run;
+    size_t i;
+    uint64_t enqueue_time;
+
+    tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail - queue->cached_head > queue->mask && !has_space(queue)) {
+        return 0;
+    }
+    run = queue->mask + 1 - (tail - queue->cached_head);
+    if (run > amount) {
+        run = amount;
+    }
+
+    enqueue_time = queue_stats_sample_time(queue->base.stats);
+    for (i = 0; i < run; i++) {
+        slot = slot_at(queue, tail + i);
+        queue_copy_value(slot->value, value_bytes + i * element_size, element_size);
+        slot->enqueue_time = i == 0 ? enqueue_time : 0;
+    }
+    atomic_store_explicit(&queue->tail, tail + run, memory_order_release);
+
+    if (enqueue_time != 0) {
+        queue_stats_record_depth(queue->base.stats,
+                                 tail + run - atomic_load_explicit(&queue->head, memory_order_relaxed));
+    }
+    wake_sleeper(&queue->consumer_state);
+    return run;
+}
+
+/**
+ * @brief Reloads tail into the consumer's cached copy and checks whether the ring holds an item.
+ *
+ * @note Used by spsc_try_dequeue and, as wake up condition, by spsc_dequeue.
+ *
+ */
+static bool has_items(SpscQueue *queue) {
+    queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    return atomic_load_explicit(&queue->head, memory_order_relaxed) != queue->cached_tail;
+}
+
+/**
+ * @brief Reloads head into the producer's cached copy and checks whether the ring has a free slot.
+ *
+ * @note Used by try_enqueue_run and, as wake up condition, by spsc_enqueue and spsc_enqueue_batch.
+ *
+ */
+static bool has_space(SpscQueue *queue) {
+    queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    return atomic_load_explicit(&queue->tail, memory_order_relaxed) - queue->cached_head <= queue->mask;
+}
+
+/**
+ * @brief Spins for up to spin_budget pauses until ready holds, then sleeps on the side's futex word.
+ *
+ * The word is set to THREAD_SLEEPING before the final check of ready, and the other side reads it after
+ * publishing its index, with a full fence on both sides. So either the final check sees the new index or
+ * the other side sees the word and wakes the thread up. A sleeping thread is counted as parked in the
+ * statistics.
+ *
+ * @param queue The queue to wait on.
+ * @param state The futex word of the calling side.
+ * @param ready The condition to wait for.
+ *
+ * @note Used by spsc_enqueue, spsc_dequeue and spsc_enqueue_batch.
+ *
+ */
+static void wait_until(SpscQueue *queue, atomic_uint *state, bool (*ready)(SpscQueue*)) {
+    // Variable declaration
+    unsigned int spins;
+
+    for (spins = 0; spins < queue->spin_budget; spins++) {
+        if (ready(queue)) {
+            return;
+        }
+        queue_cpu_relax();
+    }
+
+    queue_stats_parked(queue->base.stats, 1);
+    for (;;) {
+        atomic_store_explicit(state, THREAD_SLEEPING, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (ready(queue)) {
+            break;
+        }
+        futex_wait(state, THREAD_SLEEPING);
+    }
+    atomic_store_explicit(state, THREAD_AWAKE, memory_order_relaxed);
+    queue_stats_parked(queue->base.stats, -1);
+}
+
+/**
+ * @brief Wakes up the other side if it sleeps on its futex word.
+ *
+ * While the other side is awake this costs a fence and a load of a line that is only written when a
+ * thread goes to sleep, so it stays cached.
+ *
+ * @param state The futex word of the side to wake.
+ *
+ * @note Used by spsc_try_dequeue and try_enqueue_run.
+ *
+ */
+static void wake_sleeper(atomic_uint *state) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(state, memory_order_relaxed) == THREAD_SLEEPING &&
+        atomic_exchange_explicit(state, THREAD_AWAKE, memory_order_relaxed) == THREAD_SLEEPING) {
+        futex_wake(state, 1);
+    }
+}
+
+#ifdef QUEUE_DEBUG
+/**
+ * @brief Claims a role of the queue for the calling thread, or aborts if another thread holds it.
+ *
+ * A thread that already holds the role only pays a relaxed load, the CAS is reserved for claiming it.
+ *
+ * @param owner The owner field of the producer or the consumer role.
+ *
+ * @note Used by spsc_enqueue, spsc_try_dequeue and spsc_enqueue_batch.
+ *
+ */
+static void check_role(_Atomic(void*) *owner) {
+    // Variable declaration
+    void *expected;
+
+    expected = atomic_load_explicit(owner, memory_order_relaxed);
+    if (expected == &thread_identity) {
+        return;
+    }
+    if (expected == NULL && atomic_compare_exchange_strong_explicit(owner, &expected, &thread_identity,
+                                                                    memory_order_relaxed, memory_order_relaxed)) {
+        return;
+    }
+    fprintf(stderr, "QUEUE_MODE_SPSC used by a second producer or consumer\n");
+    abort();
+}
+#endif
+
+/* Used sources
+    1. Single producer single consumer ring: https://www.1024cores.net/home/lock-free-algorithms/queues/unbounded-spsc-queue
+    2. Futex: https://man7.org/linux/man-pages/man2/futex.2.html
+*/
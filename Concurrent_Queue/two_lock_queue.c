@@ -0,0 +1,417 @@
+// Includes
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+#include "node_pool.h"
+#include "parker.h"
+#include "queue_internal.h"
+#include "queue_stats.h"
+
+// Struct defs
+typedef struct TwoLockNode {
+    _Atomic(struct TwoLockNode*) next;
+    uint64_t enqueue_time;
+    unsigned char value[];
+} TwoLockNode;
+
+typedef struct {
+    ConcurrentQueue base;
+    _Alignas(QUEUE_CACHE_LINE) TwoLockNode *head;
+    mtx_t head_lock;
+    atomic_size_t visited_items;
+    _Alignas(QUEUE_CACHE_LINE) TwoLockNode *tail;
+    mtx_t tail_lock;
+    _Alignas(QUEUE_CACHE_LINE) Parker parker;
+    _Alignas(QUEUE_CACHE_LINE) mtx_t pool_lock;
+    NodePool node_pool;
+} TwoLockQueue;
+
+typedef struct {
+    TwoLockQueue *queue;
+    void *value;
+} TwoLockAttempt;
+
+
+// Function declaration
+static bool two_lock_enqueue(ConcurrentQueue*, const void*);
+static void two_lock_dequeue(ConcurrentQueue*, void*);
+static bool two_lock_try_dequeue(ConcurrentQueue*, void*);
+static size_t two_lock_enqueue_batch(ConcurrentQueue*, const void*, size_t);
+static size_t two_lock_visited(ConcurrentQueue*);
+static void two_lock_destroy(ConcurrentQueue*);
+static bool attempt_dequeue(void*);
+static void link_chain(TwoLockQueue*, TwoLockNode*, TwoLockNode*);
+static TwoLockNode* init_node(TwoLockQueue*, const void*);
+static void free_node(TwoLockQueue*, TwoLockNode*);
+
+
+// Global variables declarations
+static const QueueOps two_lock_ops = {
+    .enqueue = two_lock_enqueue,
+    .dequeue = two_lock_dequeue,
+    .try_dequeue = two_lock_try_dequeue,
+    .enqueue_batch = two_lock_enqueue_batch,
+    .visited = two_lock_visited,
+    .destroy = two_lock_destroy,
+};
+
+/*Interface methods*/
+
+/**
+ * @brief Creates a two lock queue, with separate locks for its head and its tail.
+ *
+ * Like the lock free mode the queue always holds a dummy node, head points at it and the first item lives
+ * in its successor. Enqueuers only touch the tail and dequeuers only the head, so the two sides never
+ * contend for a lock. The head side, the tail side and the parker each start on their own cache line so
+ * producers and consumers do not false share either.
+ *
+ * @param config The configuration of the queue. Every node holds a value of element_size bytes, the node
+ * pool shared by both sides is prewarmed with pool_prewarm nodes and keeps at most pool_max_retained.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation failed.
+ *
+ */
+ConcurrentQueue* two_lock_queue_create(const QueueConfig *config) {
+    // Variable declaration
+    TwoLockQueue *queue;
+    TwoLockNode *dummy;
+
+    queue = aligned_alloc(QUEUE_CACHE_LINE, sizeof(TwoLockQueue));
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    if (mtx_init(&queue->pool_lock, mtx_plain) != thrd_success) {
+        free(queue);
+        return NULL;
+    }
+    if (!node_pool_init(&queue->node_pool, sizeof(TwoLockNode) + config->element_size, config->pool_prewarm,
+                        config->pool_max_retained)) {
+        mtx_destroy(&queue->pool_lock);
+        free(queue);
+        return NULL;
+    }
+    dummy = init_node(queue, NULL);
+    if (dummy == NULL) {
+        node_pool_destroy(&queue->node_pool);
+        mtx_destroy(&queue->pool_lock);
+        free(queue);
+        return NULL;
+    }
+    if (mtx_init(&queue->head_lock, mtx_plain) != thrd_success) {
+        free_node(queue, dummy);
+        node_pool_destroy(&queue->node_pool);
+        mtx_destroy(&queue->pool_lock);
+        free(queue);
+        return NULL;
+    }
+    if (mtx_init(&queue->tail_lock, mtx_plain) != thrd_success) {
+        mtx_destroy(&queue->head_lock);
+        free_node(queue, dummy);
+        node_pool_destroy(&queue->node_pool);
+        mtx_destroy(&queue->pool_lock);
+        free(queue);
+        return NULL;
+    }
+    if (!parker_init(&queue->parker)) {
+        mtx_destroy(&queue->tail_lock);
+        mtx_destroy(&queue->head_lock);
+        free_node(queue, dummy);
+        node_pool_destroy(&queue->node_pool);
+        mtx_destroy(&queue->pool_lock);
+        free(queue);
+        return NULL;
+    }
+
+    queue->base.ops = &two_lock_ops;
+    queue->head = dummy;
+    queue->tail = dummy;
+    atomic_init(&queue->visited_items, 0);
+    return &queue->base;
+}
+
+/*Private methods*/
+
+/**
+ * @brief Links a new node after the tail under the tail lock and wakes up a parked consumer if one exists.
+ *
+ * The node is allocated before the lock is taken, so the critical section is two stores. The queue does
+ * not know its own depth, so it is only offered as high water mark on enqueues sampled for the sojourn
+ * histogram.
+ *
+ * @param base The queue to enqueue into.
+ * @param element_to_enqueue The value to copy into the new node.
+ *
+ * @return True if the value was enqueued, false if its node could not be allocated.
+ *
+ * @note Used through two_lock_ops.
+ *
+ */
+static bool two_lock_enqueue(ConcurrentQueue *base, const void *element_to_enqueue) {
+    // Variable declaration
+    TwoLockQueue *queue = (TwoLockQueue*)base;
+    TwoLockNode *new_node;
+    uint64_t enqueue_time;
+
+    new_node = init_node(queue, element_to_enqueue);
+    if (new_node == NULL) {
+        return false;
+    }
+    enqueue_time = queue_stats_sample_time(base->stats);
+    new_node->enqueue_time = enqueue_time;
+
+    // The node may be dequeued and recycled as soon as it is linked
+    link_chain(queue, new_node, new_node);
+    if (enqueue_time != 0) {
+        queue_stats_record_depth(base->stats, queue_stats_depth(base->stats));
+    }
+    parker_wake(&queue->parker);
+    return true;
+}
+
+/**
+ * @brief Dequeues an item, parking the calling thread while the queue is empty.
+ *
+ * A thread whose first attempt failed is counted as parked in the statistics until it got its item.
+ *
+ * @param base The queue to dequeue from.
+ * @param value The location in which to save the dequeued value.
+ *
+ * @note Used through two_lock_ops.
+ *
+ */
+static void two_lock_dequeue(ConcurrentQueue *base, void *value) {
+    // Variable declaration
+    TwoLockAttempt attempt;
+
+    attempt.queue = (TwoLockQueue*)base;
+    attempt.value = value;
+    if (!attempt_dequeue(&attempt)) {
+        queue_stats_parked(base->stats, 1);
+        parker_wait(&attempt.queue->parker, attempt_dequeue, &attempt);
+        queue_stats_parked(base->stats, -1);
+    }
+}
+
+/**
+ * @brief Moves the head to the dummy's successor under the head lock and copies out the successor's value.
+ *
+ * The successor becomes the new dummy and the old dummy is recycled once the lock was released. The value
+ * is copied while the lock is held, since afterwards another dequeuer may move past the new dummy and
+ * recycle it. The dummy's next field is the only location both sides access, an enqueuer publishes it
+ * with a release store while the queue holds a single node, hence it is read with an acquire load.
+ *
+ * @param base The queue to dequeue from.
+ * @param item_of_element_to_dequeue The location in which to save the dequeued value.
+ *
+ * @return True if an item was dequeued, false if the queue was empty.
+ *
+ * @note Used through two_lock_ops and by attempt_dequeue.
+ *
+ */
+static bool two_lock_try_dequeue(ConcurrentQueue *base, void *item_of_element_to_dequeue) {
+    // Variable declaration
+    TwoLockQueue *queue = (TwoLockQueue*)base;
+    TwoLockNode *old_dummy;
+    TwoLockNode *new_dummy;
+    uint64_t enqueue_time;
+
+    queue_stats_lock(base->stats, &queue->head_lock);
+
+    old_dummy = queue->head;
+    new_dummy = atomic_load_explicit(&old_dummy->next, memory_order_acquire);
+    if (new_dummy == NULL) {
+        mtx_unlock(&queue->head_lock);
+        return false;
+    }
+    queue_copy_value(item_of_element_to_dequeue, new_dummy->value, base->element_size);
+    enqueue_time = new_dummy->enqueue_time;
+    queue->head = new_dummy;
+    atomic_store_explicit(&queue->visited_items,
+                          atomic_load_explicit(&queue->visited_items, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+
+    mtx_unlock(&queue->head_lock);
+
+    free_node(queue, old_dummy);
+    queue_stats_record_sojourn(base->stats, enqueue_time);
+    return true;
+}
+
+/**
+ * @brief Enqueues several items, linking their nodes into a chain before taking the tail lock once.
+ *
+ * One parked consumer is woken up per item, which costs a single atomic load per item while none is
+ * parked.
+ *
+ * @return The amount of items enqueued, less than amount only if a node could not be allocated.
+ *
+ * @note Used through two_lock_ops.
+ *
+ */
+static size_t two_lock_enqueue_batch(ConcurrentQueue *base, const void *values, size_t amount) {
+    // Variable declaration
+    TwoLockQueue *queue = (TwoLockQueue*)base;
+    const unsigned char *value_bytes = values;
+    TwoLockNode *first_node = NULL;
+    TwoLockNode *last_node = NULL;
+    TwoLockNode *new_node;
+    size_t enqueued_amount;
+    size_t i;
+
+    for (enqueued_amount = 0; enqueued_amount < amount; enqueued_amount++) {
+        new_node = init_node(queue, value_bytes + enqueued_amount * base->element_size);
+        if (new_node == NULL) {
+            break;
+        }
+        new_node->enqueue_time = queue_stats_sample_time(base->stats);
+        if (first_node == NULL) {
+            first_node = new_node;
+        }
+        else {
+            atomic_store_explicit(&last_node->next, new_node, memory_order_relaxed);
+        }
+        last_node = new_node;
+    }
+
+    if (enqueued_amount > 0) {
+        link_chain(queue, first_node, last_node);
+        for (i = 0; i < enqueued_amount; i++) {
+            parker_wake(&queue->parker);
+        }
+    }
+    return enqueued_amount;
+}
+
+/**
+ * @brief Returns the amount of items dequeued from the queue.
+ *
+ * @note Used through two_lock_ops.
+ *
+ */
+static size_t two_lock_visited(ConcurrentQueue *base) {
+    return atomic_load_explicit(&((TwoLockQueue*)base)->visited_items, memory_order_relaxed);
+}
+
+/**
+ * @brief Frees every node still linked in the queue, the node pool, the locks, the parker and the queue.
+ *
+ * No thread may be operating on the queue while it is destroyed.
+ *
+ * @note Used through two_lock_ops.
+ *
+ */
+static void two_lock_destroy(ConcurrentQueue *base) {
+    // Variable declaration
+    TwoLockQueue *queue = (TwoLockQueue*)base;
+    TwoLockNode *current_node;
+    TwoLockNode *next_node;
+
+    current_node = queue->head;
+    while (current_node != NULL) {
+        next_node = atomic_load_explicit(&current_node->next, memory_order_relaxed);
+        free_node(queue, current_node);
+        current_node = next_node;
+    }
+
+    node_pool_destroy(&queue->node_pool);
+    parker_destroy(&queue->parker);
+    mtx_destroy(&queue->pool_lock);
+    mtx_destroy(&queue->tail_lock);
+    mtx_destroy(&queue->head_lock);
+    free(queue);
+}
+
+/**
+ * @brief Adapts two_lock_try_dequeue to the parker_wait attempt signature.
+ *
+ * @param context A pointer to a TwoLockAttempt.
+ *
+ * @note Used by two_lock_dequeue.
+ *
+ */
+static bool attempt_dequeue(void *context) {
+    // Variable declaration
+    TwoLockAttempt *attempt = context;
+
+    return two_lock_try_dequeue(&attempt->queue->base, attempt->value);
+}
+
+/**
+ * @brief Appends a chain of linked nodes after the tail under the tail lock.
+ *
+ * The release store publishes the whole chain, including the links between its nodes, to the dequeuer
+ * that reads it with an acquire load.
+ *
+ * @param queue The queue to append to.
+ * @param first_node The first node of the chain.
+ * @param last_node The last node of the chain, whose next field is NULL.
+ *
+ * @note Used by two_lock_enqueue and two_lock_enqueue_batch.
+ *
+ */
+static void link_chain(TwoLockQueue *queue, TwoLockNode *first_node, TwoLockNode *last_node) {
+    queue_stats_lock(queue->base.stats, &queue->tail_lock);
+    atomic_store_explicit(&queue->tail->next, first_node, memory_order_release);
+    queue->tail = last_node;
+    mtx_unlock(&queue->tail_lock);
+}
+
+/**
+ * @brief Takes a node from the calling thread's cache, the node pool or the heap, and copies a value into it.
+ *
+ * The pool lock is only taken once the thread cache is empty, which in a producer consumer setup is how
+ * the nodes the consumer released reach the producer.
+ *
+ * @param queue The queue whose node pool to allocate from.
+ * @param element_to_enqueue The value of the node, NULL for the dummy.
+ *
+ * @return The new node, or NULL if memory allocation failed.
+ *
+ * @note Used by two_lock_queue_create, two_lock_enqueue and two_lock_enqueue_batch.
+ *
+ */
+static TwoLockNode* init_node(TwoLockQueue *queue, const void *element_to_enqueue) {
+    // Variable declaration
+    TwoLockNode *new_node;
+
+    new_node = node_cache_take(queue->node_pool.node_size);
+    if (new_node == NULL) {
+        mtx_lock(&queue->pool_lock);
+        new_node = node_pool_alloc(&queue->node_pool);
+        mtx_unlock(&queue->pool_lock);
+        if (new_node == NULL) {
+            return NULL;
+        }
+    }
+    atomic_init(&new_node->next, NULL);
+    if (element_to_enqueue != NULL) {
+        queue_copy_value(new_node->value, element_to_enqueue, queue->base.element_size);
+    }
+    new_node->enqueue_time = 0;
+    return new_node;
+}
+
+/**
+ * @brief Returns a node to the calling thread's cache, the node pool, or the heap, whichever has room first.
+ *
+ * The pool lock is only taken once the thread cache is full.
+ *
+ * @note Used by two_lock_try_dequeue, two_lock_destroy and on creation failure.
+ *
+ */
+static void free_node(TwoLockQueue *queue, TwoLockNode *node) {
+    if (node_cache_put(node, queue->node_pool.node_size)) {
+        return;
+    }
+    mtx_lock(&queue->pool_lock);
+    node_pool_release(&queue->node_pool, node);
+    mtx_unlock(&queue->pool_lock);
+}
+
+/* Used sources
+    1. Two lock queue: https://www.cs.rochester.edu/u/scott/papers/1996_PODC_queues.pdf
+    2. Concurrency methods: https://en.cppreference.com/w/c/thread
+*/
@@ -12,7 +12,7 @@
 
 int main(int argc, char *argv[]) {   
     // Variable declaration 
-    char message[BUFF_SIZE];
+    static char message[MAX_MESSAGE_SIZE];
     ssize_t message_len;
     int file_descriptor;
     unsigned long channel_id;
@@ -38,7 +38,7 @@ int main(int argc, char *argv[]) {
         close(file_descriptor);
         exit(FAILURE);
     }
-    message_len = read(file_descriptor, message, BUFF_SIZE);
+    message_len = read(file_descriptor, message, MAX_MESSAGE_SIZE);
     // Read the message to the requested channel
     if (message_len < 0) {
         perror("An error has occurred when trying to read the message from the specified channel.");
@@ -5,8 +5,17 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
+#include <linux/refcount.h>
+#include <linux/seqlock.h>
+#include <linux/spinlock.h>
 #include <linux/string.h>
+#include <linux/wait.h>
+#include <linux/xarray.h>
 #include "message_slot.h"
 
 // License
@@ -25,20 +34,38 @@ struct file_operations Fops = {
     .write = device_write,
     .open = device_open,
     .unlocked_ioctl = device_ioctl,
+    .poll = device_poll,
     .release = device_release,
 };
 
+typedef struct Message {
+    refcount_t refcount;
+    size_t size_of_message;
+    char data[];
+} Message;
+
 typedef struct Channel {
+#ifndef CHANNEL_INDEX_XARRAY
     struct rb_node channel_node;
-    char message[BUFF_SIZE];
-    size_t size_of_message;
+#endif
+    refcount_t refcount;
+    spinlock_t message_lock;
+    Message *message;
+    wait_queue_head_t message_wait;
     unsigned int channel_id;
 } Channel;
 
 typedef struct MessageSlot {
     int minor_number;
     int channel_amount;
+    size_t max_message_size;
+    struct mutex insert_lock;
+#ifdef CHANNEL_INDEX_XARRAY
+    struct xarray channels;
+#else
+    seqcount_mutex_t tree_sequence;
     struct rb_root channels;
+#endif
 } MessageSlot;
 
 typedef struct MessageSlotManager {
@@ -48,16 +75,26 @@ typedef struct MessageSlotManager {
 
 // Statics
 static MessageSlotManager manager;
+static DEFINE_MUTEX(manager_lock);
 
 // Function declaration
 static int create_message_slot(struct inode*);
 static Channel *create_channel(unsigned int);
+static long set_channel(struct file*, unsigned long);
+static long set_max_message_size(struct file*, unsigned long, bool);
 static ssize_t copy_user_message(Channel*, const char __user*, size_t);
-static ssize_t copy_channel_message(Channel*, const char __user*);
+static Message* get_channel_message(Channel*);
+static ssize_t copy_channel_message(Message*, char __user*);
+static void put_message(Message*);
+static void put_channel(Channel*);
 static MessageSlot* get_files_message_slot(struct file *);
+static void init_channel_index(MessageSlot*);
+static Channel* lookup_channel(MessageSlot*, unsigned int);
+static int insert_channel(MessageSlot*, unsigned int, Channel**);
+static void cleanup_channels(MessageSlot*);
+#ifndef CHANNEL_INDEX_XARRAY
 static Channel* find_channel(struct rb_root*, unsigned int);
-static int insert_channel(struct rb_root*, unsigned int);
-static void cleanup_tree(struct rb_root*);
+#endif
 
 /*
     Driver methods
@@ -86,60 +123,41 @@ int device_open(struct inode *inode , struct file *file) {
     if (minor_number < 0) {
         return minor_number;
     }
-    file->private_data = (void *)(uintptr_t)0;
+    file->private_data = NULL;
     return SUCCESS;
 }
 
-long device_ioctl(struct file *file, unsigned int command_code, unsigned long channel_id) {
-    // Variable declaration
-    unsigned int integer_channel_id = (unsigned int) channel_id;
-    int result;
-    MessageSlot *given_files_message_slot;
-
-    if (command_code != MSG_SLOT_CHANNEL || integer_channel_id == 0) {
-        return -EINVAL;
-    }
-
-    given_files_message_slot = get_files_message_slot(file);
-
-    // Check if the requested channel already exists
-    if (find_channel(&given_files_message_slot->channels, integer_channel_id) != NULL) {
-        file->private_data = (void *)(uintptr_t)integer_channel_id;
-        return SUCCESS;
-    }
-
-    // Insert a new channel into a MessageSlot that already has channels
-    result = insert_channel(&given_files_message_slot->channels, integer_channel_id);
-    if (result < 0) {
-        printk("Error with memory allocation.\n");
-        return result;
+long device_ioctl(struct file *file, unsigned int command_code, unsigned long ioctl_param) {
+    switch (command_code) {
+        case MSG_SLOT_CHANNEL:
+            return set_channel(file, ioctl_param);
+        case MSG_SLOT_SET_MAX_SIZE:
+            return set_max_message_size(file, ioctl_param, false);
+        case MSG_SLOT_RAISE_MAX_SIZE:
+            return set_max_message_size(file, ioctl_param, true);
+        default:
+            return -EINVAL;
     }
-    file->private_data = (void *)(uintptr_t)channel_id;
-    given_files_message_slot->channel_amount++;
-    return SUCCESS;
 }
 
 ssize_t device_write(struct file *file, const char __user* user_message, size_t message_len, loff_t *offset) {
     // Variable declaration
     ssize_t result;
-    unsigned int given_files_channel_id = (unsigned int)(uintptr_t)file->private_data;
-    struct rb_root *root;
-    Channel *given_files_channel;
+    MessageSlot *given_files_message_slot;
+    Channel *given_files_channel = READ_ONCE(file->private_data);
     
 
-    if (message_len == 0 || message_len > BUFF_SIZE) {
-        printk("Unsupported message length.\n");
-        return -EMSGSIZE;
-    }
-
-    if (given_files_channel_id == 0){
+    if (given_files_channel == NULL){
         printk("No channel has been set for this file.\n");
         return -EINVAL;
     }
 
-    root = &get_files_message_slot(file)->channels;
+    given_files_message_slot = get_files_message_slot(file);
+    if (message_len == 0 || message_len > READ_ONCE(given_files_message_slot->max_message_size)) {
+        printk("Unsupported message length.\n");
+        return -EMSGSIZE;
+    }
 
-    given_files_channel = find_channel(root, given_files_channel_id);
     result = copy_user_message(given_files_channel, user_message, message_len);
     if (result  < 0) {
         printk("Error during message copying process.\n");
@@ -149,53 +167,63 @@ ssize_t device_write(struct file *file, const char __user* user_message, size_t
 
 ssize_t device_read(struct file *file, char __user* user_buffer, size_t buffer_len, loff_t *offset) {
     // Variable declaration
-    unsigned int given_files_channel_id = (unsigned int)(uintptr_t)file->private_data;
-    struct rb_root *root;
-    Channel *given_files_channel;
-    size_t current_message_len;
+    Channel *given_files_channel = READ_ONCE(file->private_data);
+    Message *current_message;
     ssize_t result;
 
-    if (given_files_channel_id == 0){
+    if (given_files_channel == NULL){
         printk("No channel has been set for this file.\n");
         return -EINVAL;
     }
 
-    root = &get_files_message_slot(file)->channels;
-
-    given_files_channel = find_channel(root, given_files_channel_id);
-    current_message_len = given_files_channel->size_of_message;
-    if (current_message_len == 0) {
-        printk("No message exists in this channel.\n");
-        return -EWOULDBLOCK;
+    // Messages are never removed, so once one was written the channel stays readable
+    current_message = get_channel_message(given_files_channel);
+    if (current_message == NULL) {
+        if (file->f_flags & O_NONBLOCK) {
+            printk("No message exists in this channel.\n");
+            return -EWOULDBLOCK;
+        }
+        result = wait_event_interruptible(given_files_channel->message_wait,
+                                          READ_ONCE(given_files_channel->message) != NULL);
+        if (result < 0) {
+            return result;
+        }
+        current_message = get_channel_message(given_files_channel);
     }
 
-    if (given_files_channel->size_of_message > buffer_len) {
+    if (current_message->size_of_message > buffer_len) {
+        put_message(current_message);
         printk("Buffer too small to hold the message.\n");
         return -ENOSPC;
     }
 
-    result = copy_channel_message(given_files_channel, user_buffer);
+    result = copy_channel_message(current_message, user_buffer);
+    put_message(current_message);
     if (result < 0) {
         printk("Error during message copying process.\n");
     }
     return result;
 }
 
-int device_release(struct inode *inode, struct file *file) {
+__poll_t device_poll(struct file *file, struct poll_table_struct *wait) {
     // Variable declaration
-    int minor_number;
-    unsigned int file_channel_id = (unsigned int)(uintptr_t)file->private_data;
-    MessageSlot *given_files_message_slot;
+    Channel *given_files_channel = READ_ONCE(file->private_data);
+    __poll_t mask = EPOLLOUT | EPOLLWRNORM;
 
-    minor_number = iminor(inode);
-    given_files_message_slot = manager.message_slots[minor_number];
+    if (given_files_channel == NULL) {
+        return EPOLLERR;
+    }
 
-    if (file_channel_id == 0) {
-        file->private_data = NULL;
-        printk("Channel closed.\n");
-        return SUCCESS;
+    poll_wait(file, &given_files_channel->message_wait, wait);
+    if (READ_ONCE(given_files_channel->message) != NULL) {
+        mask |= EPOLLIN | EPOLLRDNORM;
     }
+    return mask;
+}
 
+int device_release(struct inode *inode, struct file *file) {
+    // Drop the file's reference to its channel, if one was set
+    put_channel(file->private_data);
     file->private_data = NULL;
     printk("Channel closed.\n");
     return SUCCESS;
@@ -205,13 +233,11 @@ static void __exit message_slot_exit(void) {
     // Varaible declaration
     int i;
     MessageSlot *current_slot;
-    struct rb_root *current_root;
 
     for (i = 0; i < MAX_MESSAGE_SLOT_AMOUNT; i++) {
         current_slot = manager.message_slots[i];
         if (current_slot != NULL) {
-            current_root = &current_slot->channels;
-            cleanup_tree(current_root);
+            cleanup_channels(current_slot);
             kfree(current_slot);
             manager.message_slots[i] = NULL;
         }
@@ -229,21 +255,27 @@ static int create_message_slot(struct inode *inode) {
     MessageSlot *new_slot;
     int minor_number;
 
-    // Check for existance
+    // Check for existance, concurrent opens of a new slot create it once
     minor_number = iminor(inode);
+    mutex_lock(&manager_lock);
     if (manager.message_slots[minor_number] != NULL){
+        mutex_unlock(&manager_lock);
         return minor_number;
     }
 
     new_slot = kmalloc(sizeof(MessageSlot), GFP_KERNEL);
     if (new_slot == NULL) {
+        mutex_unlock(&manager_lock);
         printk("failed to allocate memory.\n");
         return -ENOMEM;
     }
     new_slot->minor_number = minor_number;
     new_slot->channel_amount = 0;
-    new_slot->channels = RB_ROOT;
+    new_slot->max_message_size = BUFF_SIZE;
+    mutex_init(&new_slot->insert_lock);
+    init_channel_index(new_slot);
     manager.message_slots[minor_number] = new_slot;
+    mutex_unlock(&manager_lock);
     return minor_number;
 }
 
@@ -256,45 +288,146 @@ static Channel* create_channel(unsigned int channel_id) {
         return NULL;
     }
 
+#ifndef CHANNEL_INDEX_XARRAY
     RB_CLEAR_NODE(&new_channel->channel_node);
+#endif
+    refcount_set(&new_channel->refcount, 1);
+    spin_lock_init(&new_channel->message_lock);
+    init_waitqueue_head(&new_channel->message_wait);
     new_channel->channel_id = channel_id;
-    memset(new_channel->message, 0, BUFF_SIZE);
-    new_channel->size_of_message = 0;
+    new_channel->message = NULL;
     return new_channel;
 }
 
-static ssize_t copy_user_message(Channel *channel, const char __user*  user_message, size_t message_len) {
+static long set_channel(struct file *file, unsigned long channel_id) {
     // Variable declaration
+    unsigned int integer_channel_id = (unsigned int) channel_id;
     int result;
-    int i;
-    char temp_message_arr[BUFF_SIZE];
+    MessageSlot *given_files_message_slot;
+    Channel *given_channel;
+    Channel *previous_channel;
 
-    memset(temp_message_arr, 0, BUFF_SIZE);
-    for (i = 0; i < message_len; i++) {
-        result = get_user(temp_message_arr[i], &user_message[i]);
-        if (result < 0) {
+    if (integer_channel_id == 0) {
+        return -EINVAL;
+    }
+
+    given_files_message_slot = get_files_message_slot(file);
+
+    // Check if the requested channel already exists
+    given_channel = lookup_channel(given_files_message_slot, integer_channel_id);
+    if (given_channel == NULL) {
+        // Insert a new channel under the slot's insert lock, unless another file inserted it meanwhile
+        mutex_lock(&given_files_message_slot->insert_lock);
+        result = insert_channel(given_files_message_slot, integer_channel_id, &given_channel);
+        if (result == SUCCESS) {
+            given_files_message_slot->channel_amount++;
+        }
+        mutex_unlock(&given_files_message_slot->insert_lock);
+        if (result < 0 && result != -EEXIST) {
+            printk("Error with memory allocation.\n");
             return result;
         }
     }
 
-    memcpy(channel->message, temp_message_arr, message_len);
-    channel->size_of_message = message_len;
-    return (ssize_t)message_len;
+    // Bind the file to the channel itself, so reads and writes never search the tree
+    refcount_inc(&given_channel->refcount);
+    previous_channel = xchg(&file->private_data, given_channel);
+    put_channel(previous_channel);
+    return SUCCESS;
 }
 
-static ssize_t copy_channel_message(Channel *channel, const char __user*  user_buffer) {
+static long set_max_message_size(struct file *file, unsigned long max_message_size, bool raise_only) {
     // Variable declaration
-    int result;
-    int i;
-    int channel_message_len = channel->size_of_message;
+    MessageSlot *given_files_message_slot;
+    size_t current_size;
+    size_t previous_size;
 
-    for (i = 0; i < channel_message_len; i++) {
-        result = put_user(channel->message[i], &user_buffer[i]);
-        if (result < 0) {
-            return result;
+    if (max_message_size == 0 || max_message_size > MAX_MESSAGE_SIZE) {
+        return -EINVAL;
+    }
+    given_files_message_slot = get_files_message_slot(file);
+    if (!raise_only) {
+        WRITE_ONCE(given_files_message_slot->max_message_size, max_message_size);
+        return SUCCESS;
+    }
+
+    // Only replace a smaller limit, so a concurrent raise to a larger size is never undone
+    current_size = READ_ONCE(given_files_message_slot->max_message_size);
+    while (current_size < max_message_size) {
+        previous_size = cmpxchg(&given_files_message_slot->max_message_size, current_size, max_message_size);
+        if (previous_size == current_size) {
+            break;
         }
+        current_size = previous_size;
+    }
+    return SUCCESS;
+}
+
+static ssize_t copy_user_message(Channel *channel, const char __user*  user_message, size_t message_len) {
+    // Variable declaration
+    Message *new_message;
+    Message *old_message;
+
+    // Copy into a fresh buffer so a faulting copy leaves the previous message intact
+    new_message = kvmalloc(sizeof(Message) + message_len, GFP_KERNEL);
+    if (new_message == NULL) {
+        return -ENOMEM;
+    }
+    if (copy_from_user(new_message->data, user_message, message_len) != 0) {
+        kvfree(new_message);
+        return -EFAULT;
+    }
+    refcount_set(&new_message->refcount, 1);
+    new_message->size_of_message = message_len;
+
+    // Only the pointer swap is done under the channel's lock, readers still copying the old message keep it alive
+    spin_lock(&channel->message_lock);
+    old_message = channel->message;
+    WRITE_ONCE(channel->message, new_message);
+    spin_unlock(&channel->message_lock);
+
+    // Wake blocked readers and pollers of this channel only
+    wake_up_interruptible(&channel->message_wait);
+    put_message(old_message);
+    return (ssize_t)message_len;
+}
+
+static Message* get_channel_message(Channel *channel) {
+    // Variable declaration
+    Message *current_message;
+
+    spin_lock(&channel->message_lock);
+    current_message = channel->message;
+    if (current_message != NULL) {
+        refcount_inc(&current_message->refcount);
+    }
+    spin_unlock(&channel->message_lock);
+    return current_message;
+}
+
+static ssize_t copy_channel_message(Message *message, char __user*  user_buffer) {
+    if (copy_to_user(user_buffer, message->data, message->size_of_message) != 0) {
+        return -EFAULT;
+    }
+    return (ssize_t)message->size_of_message;
+}
+
+static void put_message(Message *message) {
+    if (message != NULL && refcount_dec_and_test(&message->refcount)) {
+        kvfree(message);
+    }
+}
+
+/*
+    A channel holds one reference for its slot's tree and one for every file bound to it. The tree's
+    reference is only dropped when the module unloads, after every file was released, so a channel read
+    from file->private_data stays valid even while another thread rebinds the file.
+*/
+static void put_channel(Channel *channel) {
+    if (channel != NULL && refcount_dec_and_test(&channel->refcount)) {
+        put_message(channel->message);
+        kfree(channel);
     }
-    return (ssize_t)channel_message_len;
 }
 
 static MessageSlot* get_files_message_slot(struct file *file) {
@@ -305,24 +438,50 @@ static MessageSlot* get_files_message_slot(struct file *file) {
     return manager.message_slots[minor_number];
 }
 
+#ifndef CHANNEL_INDEX_XARRAY
+
 /*
     Red black tree methods
 */
 
+static void init_channel_index(MessageSlot *slot) {
+    seqcount_mutex_init(&slot->tree_sequence, &slot->insert_lock);
+    slot->channels = RB_ROOT;
+}
+
+/*
+    Channels are inserted under the slot's insert lock and never removed while the module is loaded. Lookups
+    walk the tree under RCU without taking any lock, a walk that raced with the rotations of an insertion may
+    miss a channel, so a miss is retried once the tree_sequence shows no insertion ran meanwhile.
+*/
+static Channel* lookup_channel(MessageSlot *slot, unsigned int search_id) {
+    // Variable declaration
+    Channel *found_channel;
+    unsigned int sequence;
+
+    do {
+        sequence = read_seqcount_begin(&slot->tree_sequence);
+        rcu_read_lock();
+        found_channel = find_channel(&slot->channels, search_id);
+        rcu_read_unlock();
+    } while (found_channel == NULL && read_seqcount_retry(&slot->tree_sequence, sequence));
+    return found_channel;
+}
+
 static Channel* find_channel(struct rb_root *root, unsigned int search_id) {
     // Variable declaration
-    struct rb_node *current_node = root->rb_node;
+    struct rb_node *current_node = rcu_dereference_raw(root->rb_node);
     Channel *current_channel;
 
     while(current_node) {
         current_channel = container_of(current_node, Channel, channel_node);
         
         if (current_channel->channel_id < search_id) {
-            current_node = current_node->rb_right;
+            current_node = rcu_dereference_raw(current_node->rb_right);
         }
 
         else if (current_channel->channel_id > search_id) {
-            current_node = current_node->rb_left;
+            current_node = rcu_dereference_raw(current_node->rb_left);
         }
 
         else{
@@ -332,8 +491,9 @@ static Channel* find_channel(struct rb_root *root, unsigned int search_id) {
     return NULL;
 }
 
-static int insert_channel (struct rb_root *root, unsigned int search_id) {
+static int insert_channel (MessageSlot *slot, unsigned int search_id, Channel **inserted_channel) {
     // Variable declaration
+    struct rb_root *root = &slot->channels;
     struct rb_node **current_node = &(root->rb_node);
     struct rb_node *parent = NULL;
     Channel *current_channel;
@@ -350,6 +510,7 @@ static int insert_channel (struct rb_root *root, unsigned int search_id) {
         }
 
         else {
+            *inserted_channel = current_channel;
             return -EEXIST;
         }
     }
@@ -358,13 +519,17 @@ static int insert_channel (struct rb_root *root, unsigned int search_id) {
     if (current_channel == NULL) {
         return -ENOMEM;
     }
-    rb_link_node(&current_channel->channel_node, parent, current_node);
+    *inserted_channel = current_channel;
+    write_seqcount_begin(&slot->tree_sequence);
+    rb_link_node_rcu(&current_channel->channel_node, parent, current_node);
     rb_insert_color(&current_channel->channel_node, root);
+    write_seqcount_end(&slot->tree_sequence);
     return SUCCESS;
 }
 
-static void cleanup_tree(struct rb_root *root) {
+static void cleanup_channels(MessageSlot *slot) {
     // Varaible declaration
+    struct rb_root *root = &slot->channels;
     Channel *current_channel;
     Channel *next_channel;
 
@@ -374,10 +539,66 @@ static void cleanup_tree(struct rb_root *root) {
 
     rbtree_postorder_for_each_entry_safe(current_channel, next_channel, root, channel_node) {
         rb_erase(&current_channel->channel_node, root);
+        put_channel(current_channel);
+    }
+}
+
+#else
+
+/*
+    XArray methods
+*/
+
+/*
+    Channel ids index an xarray directly, dense ids share the array's 64 slot nodes instead of paying for
+    an rb_node each, and a lookup is a short radix walk. xa_load is safe under RCU by itself, so lookups
+    take no lock and need no retry, insertions still take the slot's insert lock.
+*/
+static void init_channel_index(MessageSlot *slot) {
+    xa_init(&slot->channels);
+}
+
+static Channel* lookup_channel(MessageSlot *slot, unsigned int search_id) {
+    return xa_load(&slot->channels, search_id);
+}
+
+static int insert_channel(MessageSlot *slot, unsigned int search_id, Channel **inserted_channel) {
+    // Variable declaration
+    Channel *current_channel;
+    int result;
+
+    current_channel = xa_load(&slot->channels, search_id);
+    if (current_channel != NULL) {
+        *inserted_channel = current_channel;
+        return -EEXIST;
+    }
+
+    current_channel = create_channel(search_id);
+    if (current_channel == NULL) {
+        return -ENOMEM;
+    }
+    result = xa_insert(&slot->channels, search_id, current_channel, GFP_KERNEL);
+    if (result < 0) {
         kfree(current_channel);
+        return result;
     }
+    *inserted_channel = current_channel;
+    return SUCCESS;
+}
+
+static void cleanup_channels(MessageSlot *slot) {
+    // Varaible declaration
+    Channel *current_channel;
+    unsigned long channel_id;
+
+    xa_for_each(&slot->channels, channel_id, current_channel) {
+        put_channel(current_channel);
+    }
+    xa_destroy(&slot->channels);
 }
 
+#endif
+
 module_init(message_slot_init);
 module_exit(message_slot_exit);
 
@@ -389,4 +610,8 @@ module_exit(message_slot_exit);
     4. Red Black trees - linux kernel: https://en.wikipedia.org/wiki/Red%E2%80%93black_tree
     5. Red Black trees - guide: https://www.kernel.org/doc/html/v5.9/core-api/rbtree.html
     6. General driver code: https://docs.oracle.com/cd/E26502_01/html/E29051/loading-112.html
+    7. RCU: https://www.kernel.org/doc/html/latest/RCU/whatisRCU.html
+    8. Sequence counters: https://www.kernel.org/doc/html/latest/locking/seqlock.html
+    9. XArray: https://www.kernel.org/doc/html/latest/core-api/xarray.html
+    10. Wait queues and poll: https://www.kernel.org/doc/html/latest/driver-api/basics.html
 */
\ No newline at end of file
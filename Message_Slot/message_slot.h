@@ -4,6 +4,7 @@
 #ifdef __KERNEL__
 #include <linux/rbtree.h>
 #include <linux/fs.h>       
+#include <linux/poll.h>
 #include <linux/uaccess.h>   
 #else
 #include <sys/ioctl.h>
@@ -12,8 +13,11 @@
 // Constants
 #define MAJOR_NUMBER 235
 #define MSG_SLOT_CHANNEL _IOW(MAJOR_NUMBER, 0, unsigned long)
+#define MSG_SLOT_SET_MAX_SIZE _IOW(MAJOR_NUMBER, 1, unsigned long)
+#define MSG_SLOT_RAISE_MAX_SIZE _IOW(MAJOR_NUMBER, 2, unsigned long)
 #define SUCCESS 0
 #define BUFF_SIZE 128
+#define MAX_MESSAGE_SIZE (64 * 1024)
 
 #ifdef __KERNEL__
 // Driver Methods
@@ -27,15 +31,19 @@
 int device_open(struct inode *inode, struct file *file);
 
 /**
- * device_ioctl - Associates a specified channel ID with the file descriptor.
+ * device_ioctl - Configures the file descriptor or its message slot.
  * @file: Pointer to the file object.
- * @command_code: Indicates the ioctl command; expected to be MSG_SLOT_CHANNEL.
- * @channel_id: The channel ID to associate with this file descriptor.
+ * @command_code: Indicates the ioctl command; MSG_SLOT_CHANNEL, MSG_SLOT_SET_MAX_SIZE or MSG_SLOT_RAISE_MAX_SIZE.
+ * @ioctl_param: The channel ID for MSG_SLOT_CHANNEL, the maximal message size for the other commands.
  *
- * Sets up the file to use the specified channel ID for subsequent read/write 
- * operations. Returns 0 on success or a negative error code on failure.
+ * MSG_SLOT_CHANNEL binds the file to the channel with the specified ID, creating it if
+ * needed, so subsequent read/write operations reach it without a lookup. MSG_SLOT_SET_MAX_SIZE sets the maximal size of the messages
+ * written to any channel of the file's slot, between 1 and MAX_MESSAGE_SIZE bytes
+ * (BUFF_SIZE by default). MSG_SLOT_RAISE_MAX_SIZE only raises it to at least the given
+ * size and never lowers a limit that is already larger. Returns 0 on success or a negative
+ * error code on failure.
  */
-long device_ioctl(struct file *file, unsigned int command_code, unsigned long channel_id);
+long device_ioctl(struct file *file, unsigned int command_code, unsigned long ioctl_param);
 
 
 /**
@@ -45,8 +53,9 @@ long device_ioctl(struct file *file, unsigned int command_code, unsigned long ch
  * @message_len: Number of bytes to write.
  * @offset: File offset (unused in this context).
  *
- * Copies @message_len bytes from @user_message into the channel's buffer. 
- * Returns the number of bytes written on success or a negative error code on failure.
+ * Copies @message_len bytes from @user_message into a buffer sized to the message, which
+ * replaces the channel's previous message. The message must not exceed the slot's maximal
+ * message size. Returns the number of bytes written on success or a negative error code on failure.
  */
 ssize_t device_write(struct file *file, const char __user* user_message, size_t message_len, loff_t *offset);
 
@@ -57,11 +66,24 @@ ssize_t device_write(struct file *file, const char __user* user_message, size_t
  * @buffer_len: Size of the user-space buffer.
  * @offset: File offset (unused in this context).
  *
- * Copies the channel's stored data into @user_buffer, up to @buffer_len bytes. 
+ * Copies the channel's stored data into @user_buffer, up to @buffer_len bytes. If no
+ * message was written to the channel yet, sleeps until one is, or fails with -EWOULDBLOCK
+ * if the file was opened with O_NONBLOCK.
  * Returns the number of bytes read on success or a negative error code on failure.
  */
 ssize_t device_read(struct file *file, char __user* user_buffer, size_t buffer_len, loff_t *offset);
 
+/**
+ * device_poll - Reports whether the currently associated channel can be read.
+ * @file: Pointer to the file object.
+ * @wait: The poll table to register the channel's wait queue with.
+ *
+ * The channel is readable once it holds a message and writable at all times. Every
+ * write wakes the channel's pollers, so an edge triggered epoll reports each new
+ * message. Returns the poll mask, EPOLLERR if no channel has been set for this file.
+ */
+__poll_t device_poll(struct file *file, struct poll_table_struct *wait);
+
 /**
  * device_release - Releases the message slot device.
  * @inode: Pointer to the inode object.
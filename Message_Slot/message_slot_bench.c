@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <errno.h>
+#include "message_slot.h"
+
+#define MIN_NUMBER_OF_ARGUMENTS 3
+#define MAX_NUMBER_OF_ARGUMENTS 4
+#define FAILURE 1
+#define FIRST_STAGE 1000
+#define STAGE_FACTOR 10
+#define LOOKUPS_PER_STAGE 1000000
+#define INVALID_COMMAND _IOW(MAJOR_NUMBER, 255, unsigned long)
+
+static uint64_t now_ns(void) {
+    // Variable declaration
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Returns the Slab line of /proc/meminfo in bytes, or 0 if it could not be read
+static long long slab_bytes(void) {
+    // Variable declaration
+    FILE *meminfo;
+    char line[256];
+    long long slab_kb = 0;
+
+    meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo == NULL) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), meminfo) != NULL) {
+        if (sscanf(line, "Slab: %lld kB", &slab_kb) == 1) {
+            break;
+        }
+    }
+    fclose(meminfo);
+    return slab_kb * 1024;
+}
+
+static void bind_channel(int file_descriptor, unsigned long channel_id) {
+    if (ioctl(file_descriptor, MSG_SLOT_CHANNEL, channel_id) < 0) {
+        perror("An error has occurred when trying to connect the device to a channel.");
+        close(file_descriptor);
+        exit(FAILURE);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // Variable declaration
+    int file_descriptor;
+    unsigned long max_channels;
+    unsigned long stride = 1;
+    unsigned long stage;
+    unsigned long inserted = 0;
+    unsigned long i;
+    uint64_t random_state = 88172645463325252ull;
+    uint64_t start;
+    double insert_ns;
+    double lookup_ns;
+    double baseline_ns;
+    long long initial_slab;
+
+    if (argc < MIN_NUMBER_OF_ARGUMENTS || argc > MAX_NUMBER_OF_ARGUMENTS) {
+        fprintf(stderr, "Usage: %s <unused slot device> <max channels> [channel id stride]\n", argv[0]);
+        exit(FAILURE);
+    }
+
+    max_channels = strtoul(argv[2], NULL, 10);
+    if (argc == MAX_NUMBER_OF_ARGUMENTS) {
+        stride = strtoul(argv[3], NULL, 10);
+    }
+    if (max_channels == 0 || stride == 0 || max_channels > UINT_MAX / stride) {
+        fprintf(stderr, "Channel ids must fit in an unsigned int.\n");
+        exit(FAILURE);
+    }
+
+    // Open device with read only access
+    file_descriptor = open(argv[1], O_RDONLY);
+    if (file_descriptor < 0) {
+        perror("An error has occurred when trying to open the message slot.");
+        exit(FAILURE);
+    }
+
+    // The cost of an ioctl that the driver rejects before touching the channel index
+    start = now_ns();
+    for (i = 0; i < LOOKUPS_PER_STAGE; i++) {
+        ioctl(file_descriptor, INVALID_COMMAND, 1ul);
+    }
+    baseline_ns = (double)(now_ns() - start) / LOOKUPS_PER_STAGE;
+    printf("ioctl baseline: %.1f ns\n", baseline_ns);
+    printf("%12s %14s %14s %20s %16s\n", "channels", "insert ns/op", "lookup ns/op", "lookup - baseline", "slab B/channel");
+
+    initial_slab = slab_bytes();
+    for (stage = FIRST_STAGE; stage <= max_channels; stage *= STAGE_FACTOR) {
+        // Insert the channels up to this stage, each ioctl on a new id creates its channel
+        start = now_ns();
+        for (i = inserted + 1; i <= stage; i++) {
+            bind_channel(file_descriptor, i * stride);
+        }
+        insert_ns = (double)(now_ns() - start) / (double)(stage - inserted);
+        inserted = stage;
+
+        // Bind to random existing channels, which only looks them up
+        start = now_ns();
+        for (i = 0; i < LOOKUPS_PER_STAGE; i++) {
+            bind_channel(file_descriptor, (next_random(&random_state) % stage + 1) * stride);
+        }
+        lookup_ns = (double)(now_ns() - start) / LOOKUPS_PER_STAGE;
+
+        printf("%12lu %14.1f %14.1f %20.1f %16.1f\n", stage, insert_ns, lookup_ns, lookup_ns - baseline_ns,
+               (double)(slab_bytes() - initial_slab) / (double)stage);
+        if (stage > max_channels / STAGE_FACTOR) {
+            break;
+        }
+    }
+
+    // Close the device and exit
+    if (close(file_descriptor) < 0) {
+        perror("An error has occurred when trying to close the device.");
+        exit(FAILURE);
+    }
+    exit(SUCCESS);
+}
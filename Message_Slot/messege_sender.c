@@ -38,8 +38,15 @@ int main(int argc, char *argv[]) {
         exit(FAILURE);
     }
 
-    // Write the message to the requested channel
+    // Make sure the slot accepts messages longer than the default, without lowering a larger limit
     message_len = strlen(argv[3]);
+    if (message_len > BUFF_SIZE && ioctl(file_descriptor, MSG_SLOT_RAISE_MAX_SIZE, (unsigned long)message_len) < 0) {
+        perror("An error has occurred when trying to raise the maximal message size of the slot.");
+        close(file_descriptor);
+        exit(FAILURE);
+    }
+
+    // Write the message to the requested channel
     if (write(file_descriptor, argv[3], message_len) != message_len) {
         perror("An error has occurred when trying to write the message to the specified channel.");
         close(file_descriptor);